@@ -28,6 +28,14 @@ SOFTWARE.
 #include "../../parMatrix/parMatrixSparse.h"
 #include "../../smg2s/smg2s.h"
 #include "../../smg2s/smg2s_nonsymmetric.h"
+#include <utility>
+
+//the generated matrix is moved into the one of the wrapper, without copy, then released
+template<class M>
+static void takeMatrix(M &dst, M *src){
+  dst = std::move(*src);
+  delete src;
+}
 
 
 #ifdef __cplusplus
@@ -158,7 +166,7 @@ void Loc_CSRGetRowsArraysComplexDoubleLongInt(struct parMatrixSparseComplexDoubl
 }
 
 void smg2sComplexDoubleLongInt(struct parMatrixSparseComplexDoubleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<std::complex<double>,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<std::complex<double>,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //complex double int
@@ -221,7 +229,7 @@ void Loc_CSRGetRowsArraysComplexDoubleInt(struct parMatrixSparseComplexDoubleInt
 }
 
 void smg2sComplexDoubleInt(struct parMatrixSparseComplexDoubleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<std::complex<double>,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<std::complex<double>,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //complex  single long int
@@ -284,7 +292,7 @@ void Loc_CSRGetRowsArraysComplexSingleLongInt(struct parMatrixSparseComplexSingl
 }
 
 void smg2sComplexSingleLongInt(struct parMatrixSparseComplexSingleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<std::complex<float>,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<std::complex<float>,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //real double long int
@@ -346,12 +354,12 @@ void Loc_CSRGetRowsArraysRealDoubleLongInt(struct parMatrixSparseRealDoubleLongI
 }
 
 void smg2sRealDoubleLongInt(struct parMatrixSparseRealDoubleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<double,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<double,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 
 void smg2sNonSymmetricRealDoubleLongInt(struct parMatrixSparseRealDoubleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s_nonsymmetric<double,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s_nonsymmetric<double,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //complex single int
@@ -414,7 +422,7 @@ void Loc_CSRGetRowsArraysComplexSingleInt(struct parMatrixSparseComplexSingleInt
 }
 
 void smg2sComplexSingleInt(struct parMatrixSparseComplexSingleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<std::complex<float>,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<std::complex<float>,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //real double int
@@ -477,12 +485,12 @@ void Loc_RealCSRGetRowsArraysRealDoubleInt(struct parMatrixSparseRealDoubleInt *
 
 
 void smg2sRealDoubleInt(struct parMatrixSparseRealDoubleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<double,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<double,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 
 void smg2sNonSymmetricRealDoubleInt(struct parMatrixSparseRealDoubleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s_nonsymmetric<double,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s_nonsymmetric<double,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 //real single long int
@@ -547,11 +555,11 @@ void Loc_RealCSRGetRowsArraysRealSingleLongInt(struct parMatrixSparseRealSingleL
 
 
 void smg2sRealSingleLongInt(struct parMatrixSparseRealSingleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<float,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<float,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 void smg2sNonSymmetricRealSingleLongInt(struct parMatrixSparseRealSingleLongInt *m, __int64_t probSize, struct NilpotencyLongInt *nilp, __int64_t lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s_nonsymmetric<float,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s_nonsymmetric<float,__int64_t>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 
@@ -614,12 +622,12 @@ void Loc_RealCSRGetRowsArraysRealSingleInt(struct parMatrixSparseRealSingleInt *
 
 
 void smg2sRealSingleInt(struct parMatrixSparseRealSingleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s<float,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s<float,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 
 void smg2sNonSymmetricRealSingleInt(struct parMatrixSparseRealSingleInt *m, int probSize, struct NilpotencyInt *nilp, int lbandwidth, char *spectrum, MPI_Comm comm){
-  m->parMatrix = *smg2s_nonsymmetric<float,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm);
+  takeMatrix(m->parMatrix, smg2s_nonsymmetric<float,int>(probSize, nilp->nilp, lbandwidth,spectrum,comm));
 }
 
 
@@ -25,6 +25,12 @@ SOFTWARE.
 
 #include "smg2s/smg2s.h"
 #include "smg2s/smg2s_nonsymmetric.h"
+#include "smg2s/smg2s_direct.h"
+#include "smg2s/smg2s_dia.h"
+#include "smg2s/smg2s_stream.h"
+#include "smg2s/smg2s_symbolic.h"
+#include "smg2s/smg2s_ensemble.h"
+#include "smg2s/smg2s_mixed.h"
 #include <math.h>
 #include <complex>
 #include <cstdlib>
@@ -32,6 +38,7 @@ SOFTWARE.
 #include "utils/logo.h"
 #include "utils/utils.h"
 #include <string>
+#include <memory>
 #include <typeinfo>  
 
 #ifdef __APPLE__
@@ -40,18 +47,249 @@ SOFTWARE.
 #include <malloc.h>
 #endif
 
+//options of the run, parsed by main
+struct runOptions
+{
+    bool non_sym, direct, symbolic, nnz_balance;
+    bool flat, dia, pooled, mixed, runcsr, time_init;
+
+    long stream_block;
+    int group_size;
+
+    std::string spectrum, outfile, ensemble;
+    std::string floattype, integertype;
+
+    //size, L and C as given on the command line
+    char *dim, *l, *c;
+};
+
+//accumulation type of -acctype DOUBLE
+template<typename T>
+struct accType {typedef T type;};
+
+template<>
+struct accType<float> {typedef double type;};
+
+template<>
+struct accType<std::complex<float> > {typedef std::complex<double> type;};
+
+
+/*Generated matrix of the modes which keep it, in each storage: it is released at the end of
+  runMode, after the timing*/
+template<typename T, typename S>
+struct runMatrices
+{
+    std::unique_ptr<parMatrixSparse<T,S> > Mt2;
+    std::unique_ptr<parMatrixSparse<T,S,sortedRow<S,T> > > Mf;
+    std::unique_ptr<parMatrixSparse<T,S,pooledMap<S,T> > > Mp;
+    std::unique_ptr<parMatrixDIA<T,S> > Md;
+};
+
+//non Hermitian generation in the selected mode, returns the global nnz for the streaming
+template<typename T, typename S>
+long runNonHerm(S probSize, Nilpotency<S> nilp, S lbandwidth, runOptions &opt, runMatrices<T,S> &M){
+
+    typedef typename accType<T>::type A;
+
+    std::string &spectrum = opt.spectrum;
+    bool nnz_balance = opt.nnz_balance;
+    long nnz_stream = 0;
+
+    if(opt.ensemble.compare(" ") != 0){
+        std::vector<smg2sJob<S> > jobs = readJobs<S>(opt.ensemble);
+        ensembleFileSink<T,S> sink(opt.outfile);
+        smg2s_ensemble<T,S>(jobs, opt.group_size, MPI_COMM_WORLD, sink, nnz_balance);
+    } else if(opt.stream_block > 0){
+        csrFileSink<T,S> sink(opt.outfile, probSize, MPI_COMM_WORLD, opt.runcsr);
+        nnz_stream = smg2s_stream<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, S(opt.stream_block), sink, nnz_balance);
+        sink.Report(MPI_COMM_WORLD);
+    } else if(opt.symbolic){
+        smg2sPattern<T,S> *pattern = smg2s_pattern<T,S>(probSize, nilp, lbandwidth, MPI_COMM_WORLD, nnz_balance);
+        parVector<T,S> *spec = pattern->NewSpec();
+        spec->specGen(spectrum);
+        pattern->Numeric(spec);
+        delete spec;
+        delete pattern;
+    } else if(opt.mixed){
+        S r0;
+        std::unique_ptr<MatrixCSR<T,S> > Mc(opt.flat ? smg2s_mixed<T,A,S,sortedRow<S,A> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, r0, nnz_balance) : smg2s_mixed<T,A,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, r0, nnz_balance));
+        csrFileSink<T,S> sink(opt.outfile, probSize, MPI_COMM_WORLD, opt.runcsr);
+        sink(r0, Mc.get());
+        sink.Report(MPI_COMM_WORLD);
+    } else if(opt.dia){
+        M.Md.reset(smg2s_dia<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance));
+    } else if(opt.flat){
+        M.Mf.reset(opt.direct ? smg2s_direct<T,S,sortedRow<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance) : smg2s<T,S,sortedRow<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+    } else if(opt.pooled){
+        M.Mp.reset(opt.direct ? smg2s_direct<T,S,pooledMap<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance) : smg2s<T,S,pooledMap<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+    } else if(opt.direct){
+        M.Mt2.reset(smg2s_direct<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance));
+    } else {
+        M.Mt2.reset(smg2s<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+    }
+
+    return nnz_stream;
+}
+
+//non symmetric generation in the selected mode, only for the real types T
+template<typename T, typename S>
+struct runNonSym
+{
+    static const bool real = true;
+
+    static long Run(S probSize, Nilpotency<S> nilp, S lbandwidth, runOptions &opt, runMatrices<T,S> &M){
+
+        typedef typename accType<T>::type A;
+
+        std::string &spectrum = opt.spectrum;
+        bool nnz_balance = opt.nnz_balance;
+        long nnz_stream = 0;
+
+        if(opt.ensemble.compare(" ") != 0){
+            std::vector<smg2sJob<S> > jobs = readJobs<S>(opt.ensemble);
+            ensembleFileSink<T,S> sink(opt.outfile);
+            smg2s_nonsymmetric_ensemble<T,S>(jobs, opt.group_size, MPI_COMM_WORLD, sink, nnz_balance);
+        } else if(opt.stream_block > 0){
+            csrFileSink<T,S> sink(opt.outfile, probSize, MPI_COMM_WORLD, opt.runcsr);
+            nnz_stream = smg2s_nonsymmetric_stream<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, S(opt.stream_block), sink, nnz_balance);
+            sink.Report(MPI_COMM_WORLD);
+        } else if(opt.symbolic){
+            smg2sPattern<T,S> *pattern = smg2s_nonsymmetric_pattern<T,S>(probSize, nilp, lbandwidth, MPI_COMM_WORLD, nnz_balance);
+            parVector<std::complex<T>,S> *spec = pattern->NewSpec2();
+            spec->specGen2(spectrum);
+            pattern->Numeric2(spec);
+            delete spec;
+            delete pattern;
+        } else if(opt.mixed){
+            S r0;
+            std::unique_ptr<MatrixCSR<T,S> > Mc(opt.flat ? smg2s_nonsymmetric_mixed<T,A,S,sortedRow<S,A> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, r0, nnz_balance) : smg2s_nonsymmetric_mixed<T,A,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, r0, nnz_balance));
+            csrFileSink<T,S> sink(opt.outfile, probSize, MPI_COMM_WORLD, opt.runcsr);
+            sink(r0, Mc.get());
+            sink.Report(MPI_COMM_WORLD);
+        } else if(opt.dia){
+            M.Md.reset(smg2s_nonsymmetric_dia<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance));
+        } else if(opt.flat){
+            M.Mf.reset(opt.direct ? smg2s_nonsymmetric_direct<T,S,sortedRow<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance) : smg2s_nonsymmetric<T,S,sortedRow<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+        } else if(opt.pooled){
+            M.Mp.reset(opt.direct ? smg2s_nonsymmetric_direct<T,S,pooledMap<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance) : smg2s_nonsymmetric<T,S,pooledMap<S,T> >(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+        } else if(opt.direct){
+            M.Mt2.reset(smg2s_nonsymmetric_direct<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance));
+        } else {
+            M.Mt2.reset(smg2s_nonsymmetric<T,S>(probSize, nilp, lbandwidth, spectrum, MPI_COMM_WORLD, nnz_balance, opt.time_init));
+        }
+
+        return nnz_stream;
+    };
+};
+
+//the complex matrices are only non Hermitian, -mattype non-sym is ignored for them
+template<typename T, typename S>
+struct runNonSym<std::complex<T>,S>
+{
+    static const bool real = false;
+
+    static long Run(S, Nilpotency<S>, S, runOptions &, runMatrices<std::complex<T>,S> &){return 0;};
+};
+
+
+/*Generation of one matrix of the scalar type T and the integer type S in the mode selected by
+  the options, timed and reported by the proc 0*/
+template<typename T, typename S>
+int runMode(runOptions &opt){
+
+    int size, rank;
+    double start, end, time;
+    long nnz_stream;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    S probSize, lbandwidth, length;
+
+    probSize = S(atol(opt.dim));
+    lbandwidth = S(atol(opt.l));
+    length = S(atol(opt.c));
+
+    Nilpotency<S> nilp;
+
+    nilp.NilpType1(length,probSize);
+
+    bool non_sym = opt.non_sym && runNonSym<T,S>::real;
+
+    runMatrices<T,S> M;
+
+    start = MPI_Wtime();
+
+    if(non_sym){
+        nnz_stream = runNonSym<T,S>::Run(probSize, nilp, lbandwidth, opt, M);
+    } else {
+        nnz_stream = runNonHerm<T,S>(probSize, nilp, lbandwidth, opt, M);
+    }
+
+    end = MPI_Wtime();
+
+    time = end - start;
+
+    if(rank == 0){
+        border_print2();
+        if(non_sym){
+            center_print ( "SMG2S Finish the Generation of Non Symmetric Matrix",100 );
+        } else {
+            center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
+        }
+        std::cout << "\n                              Size = "<< demical<S>(probSize) <<"e^" << pw<S>(probSize) << ", L = " << opt.l << ", C = " << opt.c << ", Proc = " << size << "\n" << std::endl;
+        std::cout <<  "                               Data Types for the test: " << opt.floattype <<", "<< opt.integertype <<  "\n" << std::endl;
+        printf ( "                                  SMG2S Time is %f seconds \n", time );
+        if(opt.stream_block > 0){
+            printf ( "                                  Streamed by blocks of %ld rows, nnz = %ld \n", opt.stream_block, nnz_stream );
+        }
+        if(opt.mixed){
+            printf ( "                                  Accumulated in DOUBLE, emitted in %s \n", opt.floattype.c_str() );
+        }
+        if(opt.ensemble.compare(" ") != 0){
+            printf ( "                                  Ensemble of the jobs of %s, groups of %d procs \n", opt.ensemble.c_str(), opt.group_size );
+        }
+        border_print2();
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
 
-    // Initialize the MPI environment
+    // Initialize the MPI environment, the OpenMP threads of the kernels make no MPI call
+#ifndef _OPENMP
     MPI_Init(&argc, &argv);
+#else
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#endif
 
     // Get the number of processes
     int size;
 
-    double start, end, time;
-
     bool non_sym = false;
 
+    bool direct = false;
+
+    bool symbolic = false;
+
+    bool nnz_balance = false;
+
+    bool flat = false;
+    bool dia = false;
+    bool pooled = false;
+
+    bool mixed = false;
+
+    bool runcsr = false;
+
+    bool time_init = false;
+
+    long stream_block = 0;
+
+    int group_size = 1;
+
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     // Get the rank of the process
@@ -70,6 +308,9 @@ int main(int argc, char** argv) {
 
     // Print off a hello world message
     if(rank == 0) printf("INFO ]> The MPI Comm World Size is %d\n", size);
+#ifdef _OPENMP
+    if(rank == 0) printf("INFO ]> The OpenMP threads per proc are %d\n", omp_get_max_threads());
+#endif
 
     if (argc < 5) {
         // Tell the user how to run the program
@@ -90,6 +331,28 @@ int main(int argc, char** argv) {
 
     std::string integertype = " ";    
 
+    std::string genmode = " ";
+
+    std::string outfile = " ";
+
+    std::string partition = " ";
+
+    std::string ensemble = " ";
+
+    std::string storage = " ";
+
+    std::string acctype = " ";
+
+    std::string csrformat = " ";
+
+    std::string timeinit = " ";
+
+    std::string band = "const";
+
+    double band_a = 1.0, band_b = 0.0;
+
+    unsigned long long seed = 0;
+
     for (int i =0; i < argc; i++){
 
         if (strcasecmp(argv[i],"-SIZE")==0){
@@ -118,329 +381,168 @@ int main(int argc, char** argv) {
         if (strcasecmp(argv[i],"-integertype")==0){
                 integertype.assign(argv[i+1]);
         }
-    }
 
-    if (floattype.compare("FLOAT") != 0 && floattype.compare("DOUBLE") != 0 && floattype.compare("CPLX_DOUBLE") != 0 && floattype.compare("CPLX_FLOAT") != 0){
-        return 0;
-    }
-
-    if (integertype.compare("INT") != 0 && integertype.compare("_INT64") != 0){
-        return 0;
-    }
-
-
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    if (mattype.compare("non-sym") == 0){
-        non_sym = true;
-    }
-
-    /*ONLY Non Hermitan cases*/
-
-    /*complex double + int*/
-
-
-    if (floattype.compare("CPLX_DOUBLE") + integertype.compare("INT") == 0){
-
-        int probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<int> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<std::complex<double>,int> *Mt2;
-
-        start = MPI_Wtime();
-
-        Mt2 =  smg2s<std::complex<double>,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-
-        end = MPI_Wtime();
-
-        time = end - start;
-
-        if(rank == 0){
-            border_print2();
-            center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-genmode")==0){
+                genmode.assign(argv[i+1]);
         }
 
-    } else if (floattype.compare("CPLX_FLOAT") + integertype.compare("INT") == 0){
-
-        int probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<int> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<std::complex<float>,int> *Mt2;
-
-        start = MPI_Wtime();
-
-        Mt2 =  smg2s<std::complex<float>,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-
-        end = MPI_Wtime();
-
-        time = end - start;
-
-        if(rank == 0){
-            border_print2();
-            center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-stream")==0){
+                stream_block = atol(argv[i+1]);
         }
 
-    } else if (floattype.compare("CPLX_DOUBLE") + integertype.compare("_INT64") == 0){
-
-        __int64_t probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<__int64_t> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<std::complex<double>,__int64_t> *Mt2;
-
-        start = MPI_Wtime();
-
-        Mt2 =  smg2s<std::complex<double>,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-
-        end = MPI_Wtime();
-
-        time = end - start;
-
-        if(rank == 0){
-            border_print2();
-            center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-outfile")==0){
+                outfile.assign(argv[i+1]);
         }
 
-    } else if (floattype.compare("CPLX_FLOAT") + integertype.compare("_INT64") == 0){
-
-        __int64_t probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<__int64_t> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<std::complex<float>,__int64_t> *Mt2;
-
-        start = MPI_Wtime();
-
-        Mt2 =  smg2s<std::complex<float>,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-
-        end = MPI_Wtime();
-
-        time = end - start;
-
-        if(rank == 0){
-            border_print2();
-            center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-partition")==0){
+                partition.assign(argv[i+1]);
         }
 
-    } else if (floattype.compare("DOUBLE") + integertype.compare("INT") == 0){
-
-
-    /*Both Non symmetric and Non Hermitan cases*/
-    
-    /*double + int*/
-
-        std::cout << floattype.compare("DOUBLE") + integertype.compare("INT") << std::endl;
-
-        int probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<int> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<double,int> *Mt2;
-
-        start = MPI_Wtime();
-
-        if(non_sym){
-            Mt2 =  smg2s<double,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-        } else {
-            Mt2 =  smg2s_nonsymmetric<double,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
+        if (strcasecmp(argv[i],"-ensemble")==0){
+                ensemble.assign(argv[i+1]);
         }
 
-        end = MPI_Wtime();
-
-        time = end - start;
-
-         if(rank == 0){
-            border_print2();
-            if(non_sym){
-                center_print ( "SMG2S Finish the Generation of Non Symmetric Matrix",100 );
-            } else {
-                center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            }  
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-groupsize")==0){
+                group_size = atoi(argv[i+1]);
         }
 
-    } else if (floattype.compare("FLOAT") + integertype.compare("INT") == 0){
-
-    /*float + int*/
-
-        int probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<int> nilp;
-
-        nilp.NilpType1(length,probSize);
-
-        parMatrixSparse<float,int> *Mt2;
-
-        start = MPI_Wtime();
-
-        if(non_sym){
-            Mt2 =  smg2s<float,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-        } else {
-            Mt2 =  smg2s_nonsymmetric<float,int>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
+        if (strcasecmp(argv[i],"-storage")==0){
+                storage.assign(argv[i+1]);
         }
 
-        end = MPI_Wtime();
-
-        time = end - start;
-
-        if(rank == 0){
-            border_print2();
-            if(non_sym){
-                center_print ( "SMG2S Finish the Generation of Non Symmetric Matrix",100 );
-            } else {
-                center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            }  
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
+        if (strcasecmp(argv[i],"-acctype")==0){
+                acctype.assign(argv[i+1]);
         }
 
-    } else if (floattype.compare("DOUBLE") + integertype.compare("_INT64") == 0){
-
-
-
-    /*double + int64*/
-
-        __int64_t probSize, lbandwidth, length;
-
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
-
-        Nilpotency<__int64_t> nilp;
+        if (strcasecmp(argv[i],"-csrformat")==0){
+                csrformat.assign(argv[i+1]);
+        }
 
-        nilp.NilpType1(length,probSize);
+        if (strcasecmp(argv[i],"-timeinit")==0){
+                timeinit.assign(argv[i+1]);
+        }
+        if (strcasecmp(argv[i],"-band")==0){
+                band.assign(argv[i+1]);
+        }
 
-        parMatrixSparse<double,__int64_t> *Mt2;
+        if (strcasecmp(argv[i],"-banda")==0){
+                band_a = atof(argv[i+1]);
+        }
 
-        start = MPI_Wtime();
+        if (strcasecmp(argv[i],"-bandb")==0){
+                band_b = atof(argv[i+1]);
+        }
 
-        if(non_sym){
-            Mt2 =  smg2s<double,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-        } else {
-            Mt2 =  smg2s_nonsymmetric<double,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
+        if (strcasecmp(argv[i],"-seed")==0){
+                seed = strtoull(argv[i+1], NULL, 10);
         }
+    }
 
-        end = MPI_Wtime();
+    if (floattype.compare("FLOAT") != 0 && floattype.compare("DOUBLE") != 0 && floattype.compare("CPLX_DOUBLE") != 0 && floattype.compare("CPLX_FLOAT") != 0){
+        MPI_Finalize();
+        return 0;
+    }
 
-        time = end - start;
+    if (integertype.compare("INT") != 0 && integertype.compare("_INT64") != 0){
+        MPI_Finalize();
+        return 0;
+    }
 
-        if(rank == 0){
-            border_print2();
-            if(non_sym){
-                center_print ( "SMG2S Finish the Generation of Non Symmetric Matrix",100 );
-            } else {
-                center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            }  
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
-        }
 
-    } else if (floattype.compare("FLOAT") + integertype.compare("_INT64") == 0){
+    MPI_Barrier(MPI_COMM_WORLD);
 
-    /*float + int64*/
+    if (mattype.compare("non-sym") == 0){
+        non_sym = true;
+    }
 
-        __int64_t probSize, lbandwidth, length;
+    if (genmode.compare("direct") == 0){
+        direct = true;
+    }
 
-        probSize = atoi(dim);
-        lbandwidth = atoi(l);
-        length = atoi(c);
+    if (genmode.compare("symbolic") == 0){
+        symbolic = true;
+    }
 
-        Nilpotency<__int64_t> nilp;
+    if (partition.compare("nnz") == 0){
+        nnz_balance = true;
+    }
 
-        nilp.NilpType1(length,probSize);
+    if (storage.compare("flat") == 0){
+        flat = true;
+    }
 
-        parMatrixSparse<float,__int64_t> *Mt2;
+    if (storage.compare("dia") == 0){
+        dia = true;
+    }
 
-        start = MPI_Wtime();
+    if (storage.compare("pool") == 0){
+        pooled = true;
+    }
 
-        if(non_sym){
-            Mt2 =  smg2s<float,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
-        } else {
-            Mt2 =  smg2s_nonsymmetric<float,__int64_t>(probSize, nilp,lbandwidth, spectrum, MPI_COMM_WORLD);
+    if (acctype.compare("DOUBLE") == 0){
+        if (floattype.compare("FLOAT") == 0 || floattype.compare("CPLX_FLOAT") == 0){
+            mixed = true;
+        } else if (rank == 0){
+            printf("INFO ]> -acctype DOUBLE only applies to the FLOAT and CPLX_FLOAT matrices\n");
         }
+    }
 
-        end = MPI_Wtime();
+    if (csrformat.compare("runs") == 0){
+        runcsr = true;
+    }
 
-        time = end - start;
+    if (timeinit.compare("global") == 0){
+        time_init = true;
+    }
 
-        if(rank == 0){
-            border_print2();
-            if(non_sym){
-                center_print ( "SMG2S Finish the Generation of Non Symmetric Matrix",100 );
-            } else {
-                center_print ( "SMG2S Finish the Generation of Non Hermitian Matrix",100 );
-            }  
-            std::cout << "\n                              Size = "<< demical<int>(probSize) <<"e^" << pw<int>(probSize) << ", L = " << l << ", C = " << c << ", Proc = " << size << "\n" << std::endl;
-            std::cout <<  "                               Data Types for the test: " << floattype <<", "<< integertype <<  "\n" << std::endl;
-            printf ( "                                  SMG2S Time is %f seconds \n", time );
-            border_print2();
-        }
+    if (!setBandRandom(band, band_a, band_b, seed)){
+        if(rank == 0) printf("ERROR ]> Unknown band distribution %s, it should be const, uniform or normal\n", band.c_str());
+        MPI_Finalize();
+        return 0;
+    }
 
+    runOptions opt;
+
+    opt.non_sym = non_sym;
+    opt.direct = direct;
+    opt.symbolic = symbolic;
+    opt.nnz_balance = nnz_balance;
+    opt.flat = flat;
+    opt.dia = dia;
+    opt.pooled = pooled;
+    opt.mixed = mixed;
+    opt.runcsr = runcsr;
+    opt.time_init = time_init;
+    opt.stream_block = stream_block;
+    opt.group_size = group_size;
+    opt.spectrum = spectrum;
+    opt.outfile = outfile;
+    opt.ensemble = ensemble;
+    opt.floattype = floattype;
+    opt.integertype = integertype;
+    opt.dim = dim;
+    opt.l = l;
+    opt.c = c;
+
+    /*Non Hermitian cases for all the types, non symmetric cases for the real types*/
+
+    if (floattype.compare("CPLX_DOUBLE") + integertype.compare("INT") == 0){
+        runMode<std::complex<double>,int>(opt);
+    } else if (floattype.compare("CPLX_FLOAT") + integertype.compare("INT") == 0){
+        runMode<std::complex<float>,int>(opt);
+    } else if (floattype.compare("CPLX_DOUBLE") + integertype.compare("_INT64") == 0){
+        runMode<std::complex<double>,__int64_t>(opt);
+    } else if (floattype.compare("CPLX_FLOAT") + integertype.compare("_INT64") == 0){
+        runMode<std::complex<float>,__int64_t>(opt);
+    } else if (floattype.compare("DOUBLE") + integertype.compare("INT") == 0){
+        runMode<double,int>(opt);
+    } else if (floattype.compare("FLOAT") + integertype.compare("INT") == 0){
+        runMode<float,int>(opt);
+    } else if (floattype.compare("DOUBLE") + integertype.compare("_INT64") == 0){
+        runMode<double,__int64_t>(opt);
+    } else if (floattype.compare("FLOAT") + integertype.compare("_INT64") == 0){
+        runMode<float,__int64_t>(opt);
     }
-    //delete Mt;
 
     MPI_Finalize();
 
@@ -28,14 +28,17 @@ SOFTWARE.
 
 #include <vector>
 
-template<typename T, typename S>
+/*Local rows in CSR format. The cols are of the index type S, the row offsets and the nnz of the
+  offset type O, S by default: with S = int, O = int64_t keeps more than 2^31 local nonzeros
+  with 32-bit cols*/
+template<typename T, typename S, typename O = S>
 struct MatrixCSR
 {
 	S	nrows;
-	S	nnz;
+	O	nnz;
 	S   ncols;
 
-	std::vector<S> rows;
+	std::vector<O> rows;
 	std::vector<S> cols;
 	std::vector<T> vals;
 
@@ -47,7 +50,7 @@ struct MatrixCSR
 //		vals = NULL;
 	};
 
-	MatrixCSR(S nnz_in, S nrows_in)
+	MatrixCSR(O nnz_in, S nrows_in)
 	{
 	
 		nnz = nnz_in;
@@ -74,7 +77,7 @@ struct MatrixCSR
 		T val;
 		S currCol;
 
-		for(S pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
+		for(O pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
 			currCol = cols[pos];
 			if (currCol == col){
 				val = vals[pos];
@@ -90,7 +93,7 @@ struct MatrixCSR
 	{
 		S currCol;
 
-		for(S pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
+		for(O pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
 			currCol = cols[pos];
 			if (currCol == col){
 				vals[pos] = val;
@@ -104,7 +107,7 @@ struct MatrixCSR
 		typename std::vector<S>::iterator it=cols.begin();
 		typename std::vector<T>::iterator itv=vals.begin();
 
-		for(S pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
+		for(O pos = rows[row - 1] - 1; pos < rows[row] - 1; ++pos){
 			currCol = cols[pos];
 			prevCol = cols[pos-1];
 			if (currCol == col){
@@ -122,7 +125,7 @@ struct MatrixCSR
 		}
 	};
 
-	void Add(MatrixCSR<T,S> m){
+	void Add(MatrixCSR<T,S,O> m){
 		S row, nnz;
 		T v1, v2, v;
 		
@@ -148,7 +151,7 @@ struct MatrixCSR
 	void Free()
 	{
 		if(nnz != 0){
-			std::vector<S>().swap(rows);
+			std::vector<O>().swap(rows);
 			std::vector<S>().swap(cols);
 			std::vector<T>().swap(vals);
 			
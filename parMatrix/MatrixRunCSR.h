@@ -0,0 +1,168 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __MATRIXRUNCSR_H__
+#define __MATRIXRUNCSR_H__
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "MatrixCSR.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*Local rows in CSR format with the cols of each row stored as runs of consecutive cols.
+
+  The rows of the generated matrices are banded: their cols form a few intervals (the lower band
+  and the bands shifted by the nilpotent matrix). A run is kept as its first col and its length
+  on 16 bits, longer intervals are split, so that an interval costs sizeof(S) + 2 bytes in place
+  of sizeof(S) per entry in MatrixCSR. The values and the row offsets are the ones of MatrixCSR.
+
+  The cols are decoded on the fly: the product with a vector sweeps each run as a dense dot
+  product, and the export gives back the cols one by one*/
+template<typename T, typename S, typename O = S>
+struct MatrixRunCSR
+{
+	S	nrows;
+	O	nnz;
+	S	ncols;
+
+	//offsets of the values of each row, as in MatrixCSR
+	std::vector<O>	rows;
+
+	//the runs of the row i are [runptr[i], runptr[i+1]), of first col runcol and of length runlen
+	std::vector<O>			runptr;
+	std::vector<S>			runcol;
+	std::vector<uint16_t>	runlen;
+
+	std::vector<T>	vals;
+
+	MatrixRunCSR()
+	{
+		nrows = 0;
+		nnz = 0;
+		ncols = 0;
+	};
+
+	//runs of the rows of csr, whose cols are sorted in each row
+	MatrixRunCSR(MatrixCSR<T,S,O> *csr)
+	{
+		S		c;
+		O		k, kend;
+		uint16_t	len;
+
+		nrows = csr->nrows;
+		nnz = csr->nnz;
+		ncols = csr->ncols;
+
+		rows = csr->rows;
+		vals = csr->vals;
+
+		runptr.reserve(nrows + 1);
+		runptr.push_back(0);
+
+		for(S i = 0; i < nrows; i++){
+			kend = csr->rows[i + 1];
+			for(k = csr->rows[i]; k < kend; k = k + len){
+				c = csr->cols[k];
+				len = 1;
+				while(k + len < kend && len < 65535 && csr->cols[k + len] == c + S(len)){
+					len++;
+				}
+				runcol.push_back(c);
+				runlen.push_back(len);
+			}
+			runptr.push_back(runcol.size());
+		}
+	};
+
+	O	GetNumRuns(){return runcol.size();};
+
+	//bytes of the indices (row offsets and cols), to be compared with CSRIndexBytes()
+	size_t IndexBytes()
+	{
+		return rows.size()*sizeof(O) + runptr.size()*sizeof(O) + runcol.size()*sizeof(S) + runlen.size()*sizeof(uint16_t);
+	};
+
+	//bytes of the indices of the same rows in MatrixCSR
+	size_t CSRIndexBytes()
+	{
+		return rows.size()*sizeof(O) + size_t(nnz)*sizeof(S);
+	};
+
+	//y = A x, where x holds the entries of the cols [xlo, xlo + length of x) covering the cols of the rows
+	void MatVec(const T *x, S xlo, T *y)
+	{
+		S		i;
+		O		r, k;
+		const T	*xr, *v;
+		T		sum;
+		int		j, len;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(r, k, xr, v, sum, j, len) schedule(static)
+#endif
+		for(i = 0; i < nrows; i++){
+			sum = T(0);
+			k = rows[i];
+			for(r = runptr[i]; r < runptr[i + 1]; r++){
+				xr = x + (runcol[r] - xlo);
+				v = vals.data() + k;
+				len = runlen[r];
+				for(j = 0; j < len; j++){
+					sum += v[j] * xr[j];
+				}
+				k = k + len;
+			}
+			y[i] = sum;
+		}
+	};
+
+	//new MatrixCSR of the same rows, with the cols decoded
+	MatrixCSR<T,S,O> *ToCSR()
+	{
+		MatrixCSR<T,S,O> *csr = new MatrixCSR<T,S,O>(nnz, nrows);
+
+		csr->ncols = ncols;
+		csr->rows = rows;
+		csr->vals = vals;
+
+		csr->cols.resize(nnz);
+
+		O k = 0;
+		for(O r = 0; r < O(runcol.size()); r++){
+			for(S c = runcol[r]; c < runcol[r] + S(runlen[r]); c++){
+				csr->cols[k] = c;
+				k++;
+			}
+		}
+
+		return csr;
+	};
+};
+
+#endif
@@ -0,0 +1,471 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __PAR_MATRIX_DIA_H__
+#define __PAR_MATRIX_DIA_H__
+
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include "../utils/MPI_DataType.h"
+#include "../parVector/parVector.h"
+#include "MatrixCSR.h"
+
+/*Distributed banded matrix in diagonal (DIA) storage, each proc holds its rows [lower, upper).
+
+  The matrix is kept as a list of diagonals of increasing offsets d = col - row, each one as a
+  dense array over the local rows: vals[k*nrows + i] is the entry (lower + i, lower + i + offsets[k]).
+  The entries of a diagonal which fall out of the matrix are kept at 0. There is no index per
+  entry, and a sweep over a diagonal is a unit stride loop.
+
+  The generated matrices are banded: the initial matrix has the diagonals [-lbandwidth, 0] (or
+  [-lbandwidth, 1] in the non symmetric case) and AM - MA moves every diagonal up by the shift of
+  the nilpotent matrix, the values only being masked at its zeros. So the generation loop of
+  smg2s() runs here with a fixed list of diagonals, see FusedAMMA()*/
+template<typename T, typename S>
+class parMatrixDIA
+{
+	private:
+		std::shared_ptr<parVectorMap<S> >	index_map;
+
+		//local rows and global size
+		S	nrows, ncols;
+		S	lower, upper;
+
+		MPI_Comm comm;
+
+		int ProcID, nProcs;
+
+		//offsets of the stored diagonals, increasing
+		std::vector<S>	offsets;
+
+		//the diagonals, one after the other
+		std::vector<T>	vals;
+
+	public:
+		//the rows of the vector vec, with the diagonals [dmin, dmax] set to 0
+		parMatrixDIA(parVector<T,S> *vec, S dmin, S dmax);
+
+		//move only, the map is shared with vec
+		parMatrixDIA(parMatrixDIA<T,S> &&X) = default;
+		parMatrixDIA<T,S> &operator=(parMatrixDIA<T,S> &&X) = default;
+		parMatrixDIA(const parMatrixDIA<T,S> &) = delete;
+		parMatrixDIA<T,S> &operator=(const parMatrixDIA<T,S> &) = delete;
+
+		parVectorMap<S> *GetMap(){return index_map.get();};
+		MPI_Comm GetComm(){return comm;};
+
+		S	GetLowerBound(){return lower;};
+		S	GetUpperBound(){return upper;};
+		S	GetGlobalSize(){return ncols;};
+		S	GetLocalSize(){return nrows;};
+
+		//number of stored diagonals, offset of the diagonal k and its values on the local rows
+		S	GetNDiag(){return offsets.size();};
+		S	GetOffset(S k){return offsets[k];};
+		T	*GetDiag(S k){return vals.data() + k*nrows;};
+
+		//position of the diagonal of offset d, -1 if it is not stored
+		S	DiagIndex(S d);
+
+		//add the diagonal of offset d set to 0 if it is not stored, returns its position
+		S	AddDiagonal(S d);
+
+		//local nnz: the stored entries different from 0
+		S	GetLocNnz();
+
+		//LOC set, the diagonal of the entry is added if needed
+		void	Loc_SetValueLocal(S row, S col, T value);
+		void	Loc_SetValue(S row, S col, T value);
+
+		//LOC set a whole local row at once
+		void	Loc_SetRowLocal(S row, S ncols_row, S *cols, T *values);
+
+		//LOC get, 0 out of the stored diagonals
+		T	Loc_GetLocalValue(S row, S col);
+		T	Loc_GetValue(S row, S col);
+
+		void	Loc_MatScale(T scale);
+
+		//this <- this + scale * X, the rows of X should be the local rows
+		void	Loc_MatAXPY(parMatrixDIA<T,S> *X, T scale);
+
+		//fused kernel: this <- AM - MA and acc <- acc + scale * this, in one sweep of the diagonals
+		void	FusedAMMA(Nilpotency<S> nilp, parMatrixDIA<T,S> *acc, T scale);
+
+		//y <- this * x, x and y distributed as the rows
+		void	MatVecProd(parVector<T,S> *x, parVector<T,S> *y);
+
+		//local rows as CSR without the zeros, the row offsets start from 0 and the cols are global
+		MatrixCSR<T,S>	*Loc_ConvertToCSR();
+
+		void	LOC_MatView();
+};
+
+
+template<typename T, typename S>
+parMatrixDIA<T,S>::parMatrixDIA(parVector<T,S> *vec, S dmin, S dmax)
+{
+	index_map = vec->ShareVecMap();
+
+	nrows = index_map->GetLocalSize();
+	ncols = index_map->GetGlobalSize();
+	lower = index_map->GetLowerBound();
+	upper = index_map->GetUpperBound();
+
+	comm = index_map->GetCurrentComm();
+	MPI_Comm_rank(comm, &ProcID);
+	MPI_Comm_size(comm, &nProcs);
+
+	for(S d = dmin; d <= dmax; d++){
+		offsets.push_back(d);
+	}
+
+	vals.assign(offsets.size()*nrows, T(0));
+}
+
+template<typename T, typename S>
+S parMatrixDIA<T,S>::DiagIndex(S d)
+{
+	typename std::vector<S>::iterator it = std::lower_bound(offsets.begin(), offsets.end(), d);
+
+	if(it == offsets.end() || *it != d){
+		return -1;
+	}
+	return it - offsets.begin();
+}
+
+template<typename T, typename S>
+S parMatrixDIA<T,S>::AddDiagonal(S d)
+{
+	typename std::vector<S>::iterator it = std::lower_bound(offsets.begin(), offsets.end(), d);
+
+	S k = it - offsets.begin();
+
+	if(it == offsets.end() || *it != d){
+		offsets.insert(it, d);
+		vals.insert(vals.begin() + k*nrows, nrows, T(0));
+	}
+	return k;
+}
+
+template<typename T, typename S>
+S parMatrixDIA<T,S>::GetLocNnz()
+{
+	S nnz = 0;
+
+	for(size_t p = 0; p < vals.size(); p++){
+		if(vals[p] != T(0)){
+			nnz++;
+		}
+	}
+	return nnz;
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::Loc_SetValueLocal(S row, S col, T value)
+{
+	if(row < 0 || row >= nrows || col < 0 || col >= ncols){
+		return;
+	}
+
+	S k = AddDiagonal(col - lower - row);
+
+	vals[k*nrows + row] = value;
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::Loc_SetValue(S row, S col, T value)
+{
+	if(row >= lower && row < upper){
+		Loc_SetValueLocal(row - lower, col, value);
+	}
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::Loc_SetRowLocal(S row, S ncols_row, S *cols, T *values)
+{
+	for(S j = 0; j < ncols_row; j++){
+		Loc_SetValueLocal(row, cols[j], values[j]);
+	}
+}
+
+template<typename T, typename S>
+T parMatrixDIA<T,S>::Loc_GetLocalValue(S row, S col)
+{
+	if(row < 0 || row >= nrows){
+		return T(0);
+	}
+
+	S k = DiagIndex(col - lower - row);
+
+	return (k < 0) ? T(0) : vals[k*nrows + row];
+}
+
+template<typename T, typename S>
+T parMatrixDIA<T,S>::Loc_GetValue(S row, S col)
+{
+	return Loc_GetLocalValue(row - lower, col);
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::Loc_MatScale(T scale)
+{
+	for(size_t p = 0; p < vals.size(); p++){
+		vals[p] = vals[p]*scale;
+	}
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::Loc_MatAXPY(parMatrixDIA<T,S> *X, T scale)
+{
+	S k, kx, i;
+	T *v, *vx;
+
+	if(X->nrows != nrows){
+		printf("ERROR ]> Loc_MatAXPY of DIA matrices with %ld and %ld local rows\n", (long)nrows, (long)X->nrows);
+		return;
+	}
+
+	for(kx = 0; kx < S(X->offsets.size()); kx++){
+		k = AddDiagonal(X->offsets[kx]);
+		v = vals.data() + k*nrows;
+		vx = X->vals.data() + kx*nrows;
+		for(i = 0; i < nrows; i++){
+			v[i] = v[i] + scale*vx[i];
+		}
+	}
+}
+
+/*AM - MA on the diagonals. For the entry (r, c) of the new matrix,
+
+		AM: old (r + shift, c) if r is not a zero row of the nilpotent matrix,
+		MA: old (r, c - shift) if c - shift is not a zero col of it,
+
+  both are on the old diagonal of offset d = c - r - shift. So the diagonal d becomes the diagonal
+  d + shift with, for the local row i,
+
+		new[i] = old[i + shift]*(AM mask of the row) - old[i]*(MA mask of the col)
+
+  which is done in place by increasing i. The rows i + shift beyond the local rows are the first
+  shift rows of the next proc, received before the sweep as in the parMatrixSparse kernel*/
+template<typename T, typename S>
+void parMatrixDIA<T,S>::FusedAMMA(Nilpotency<S> nilp, parMatrixDIA<T,S> *acc, T scale)
+{
+	S i, k, ka, d, r, c, shift, nhalo, ndiag;
+	T am, ma, *v, *va;
+
+	int up, down;
+
+	shift = nilp.diagPosition - 1;
+	ndiag = offsets.size();
+
+	up = (ProcID == 0) ? MPI_PROC_NULL : ProcID - 1;
+	down = (ProcID == nProcs - 1) ? MPI_PROC_NULL : ProcID + 1;
+
+	MPI_Datatype MPI_SCALAR = MPI_Scalar<T>();
+
+	//the first shift rows of every diagonal go to the previous proc, row by row
+	nhalo = (shift < nrows) ? shift : nrows;
+
+	std::vector<T> sBuf(shift*ndiag, T(0)), rBuf(shift*ndiag, T(0));
+
+	for(i = 0; i < nhalo; i++){
+		for(k = 0; k < ndiag; k++){
+			sBuf[i*ndiag + k] = vals[k*nrows + i];
+		}
+	}
+
+	MPI_Sendrecv(sBuf.data(), shift*ndiag, MPI_SCALAR, up, 0, rBuf.data(), shift*ndiag, MPI_SCALAR, down, 0, comm, MPI_STATUS_IGNORE);
+
+	MPI_Type_free(&MPI_SCALAR);
+
+	for(k = 0; k < ndiag; k++){
+
+		d = offsets[k];
+		v = vals.data() + k*nrows;
+
+		for(i = 0; i < nrows; i++){
+
+			r = lower + i;
+			c = r + d + shift;
+
+			am = T(0);
+			if((r + 1)%(nilp.nbOne + 1) != 0){
+				am = (i + shift < nrows) ? v[i + shift] : rBuf[(i + shift - nrows)*ndiag + k];
+			}
+
+			ma = T(0);
+			if(c < ncols && (c + 1)%(nilp.nbOne + 1) != 0){
+				ma = v[i];
+			}
+
+			v[i] = am - ma;
+		}
+
+		offsets[k] = d + shift;
+
+		//acc <- acc + scale * new diagonal
+		ka = acc->AddDiagonal(d + shift);
+		va = acc->vals.data() + ka*nrows;
+
+		for(i = 0; i < nrows; i++){
+			va[i] = va[i] + scale*v[i];
+		}
+	}
+}
+
+/*y <- this * x. The proc needs the entries [lower + min offset, upper + max offset) of x, which it
+  gets from the procs owning them: the windows of all the procs are gathered first, then each proc
+  sends the part of its entries in each window. Then y is computed diagonal by diagonal on the
+  rows whose col lies in the matrix*/
+template<typename T, typename S>
+void parMatrixDIA<T,S>::MatVecProd(parVector<T,S> *x, parVector<T,S> *y)
+{
+	S i, k, d, ibeg, iend;
+	T *v, *xw;
+
+	S win[4], lb, ub;
+
+	int p;
+
+	MPI_Datatype MPI_INDEX = MPI_Index<S>();
+	MPI_Datatype MPI_SCALAR = MPI_Scalar<T>();
+
+	//window of x needed here, clipped to the matrix
+	win[0] = lower;
+	win[1] = upper;
+	win[2] = offsets.empty() ? lower : lower + offsets.front();
+	win[3] = offsets.empty() ? lower : upper + offsets.back();
+	win[2] = (win[2] < 0) ? 0 : win[2];
+	win[3] = (win[3] > ncols) ? ncols : win[3];
+	win[3] = (win[3] < win[2]) ? win[2] : win[3];
+
+	std::vector<S> wins(4*nProcs);
+
+	MPI_Allgather(win, 4, MPI_INDEX, wins.data(), 4, MPI_INDEX, comm);
+
+	std::vector<T> xwin(win[3] - win[2]);
+	std::vector<MPI_Request> reqs;
+
+	T *xloc = x->GetArray();
+
+	for(p = 0; p < nProcs; p++){
+		//my entries in the window of p
+		lb = std::max(wins[4*p + 2], lower);
+		ub = std::min(wins[4*p + 3], upper);
+		if(ub > lb && p != ProcID){
+			reqs.push_back(MPI_Request());
+			MPI_Isend(xloc + lb - lower, ub - lb, MPI_SCALAR, p, 0, comm, &reqs.back());
+		}
+
+		//the entries of p in my window
+		lb = std::max(win[2], wins[4*p]);
+		ub = std::min(win[3], wins[4*p + 1]);
+		if(ub > lb){
+			if(p == ProcID){
+				std::copy(xloc + lb - lower, xloc + ub - lower, xwin.begin() + (lb - win[2]));
+			}else{
+				reqs.push_back(MPI_Request());
+				MPI_Irecv(xwin.data() + lb - win[2], ub - lb, MPI_SCALAR, p, 0, comm, &reqs.back());
+			}
+		}
+	}
+
+	MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+
+	MPI_Type_free(&MPI_SCALAR);
+
+	T *yloc = y->GetArray();
+
+	for(i = 0; i < nrows; i++){
+		yloc[i] = T(0);
+	}
+
+	//x entry of the col lower + i + d of the window
+	xw = xwin.data() + lower - win[2];
+
+	for(k = 0; k < S(offsets.size()); k++){
+		d = offsets[k];
+		v = vals.data() + k*nrows;
+
+		ibeg = std::max(S(0), -lower - d);
+		iend = std::min(nrows, ncols - lower - d);
+
+		for(i = ibeg; i < iend; i++){
+			yloc[i] = yloc[i] + v[i]*xw[i + d];
+		}
+	}
+}
+
+template<typename T, typename S>
+MatrixCSR<T,S> *parMatrixDIA<T,S>::Loc_ConvertToCSR()
+{
+	S i, k, count = 0;
+	T val;
+
+	MatrixCSR<T,S> *csr = new MatrixCSR<T,S>(GetLocNnz(), nrows);
+
+	csr->ncols = ncols;
+
+	for(i = 0; i < nrows; i++){
+		csr->rows.push_back(count);
+		for(k = 0; k < S(offsets.size()); k++){
+			val = vals[k*nrows + i];
+			if(val != T(0)){
+				csr->cols.push_back(lower + i + offsets[k]);
+				csr->vals.push_back(val);
+				count++;
+			}
+		}
+	}
+	csr->rows.push_back(count);
+
+	return csr;
+}
+
+template<typename T, typename S>
+void parMatrixDIA<T,S>::LOC_MatView()
+{
+	S i, k;
+	T val;
+
+	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
+
+	for(i = 0; i < nrows; i++){
+		std::cout << "row " << lower + i << ": ";
+		for(k = 0; k < S(offsets.size()); k++){
+			val = vals[k*nrows + i];
+			if(val != T(0)){
+				std::cout <<"("<< lower + i + offsets[k] << "," << val << "); ";
+			}
+		}
+		std::cout << std::endl;
+	}
+}
+
+#endif
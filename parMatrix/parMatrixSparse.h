@@ -33,29 +33,51 @@ SOFTWARE.
 #include <sstream>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <utility>
 #include "../utils/MPI_DataType.h"
 #include "../parVector/parVector.h"
 //#include "../utils/utils.h"
 #include "MatrixCSR.h"
+#include "spmvPlan.h"
+#include "sortedRow.h"
+#include "rowPool.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef __USE_COMPLEX__
 #include <complex>
 #endif
 
-template<typename T, typename S>
+/*Distributed sparse matrix, each proc holds its rows [lower_y, upper_y). The local rows are
+  stored in dynamic rows of type R, std::map<S,T> by default for the ad-hoc inserts in any
+  order, or sortedRow<S,T> (see sortedRow.h), a sorted contiguous array, for the rows built by
+  increasing cols as in the generation, which needs much less memory and is faster to sweep.
+  With pooledMap<S,T> (see rowPool.h), the nodes of the std::map rows come from a pool owned by
+  the matrix, without a malloc per insert, and are given back at once with the matrix: for the
+  trivially destructible S and T, the trees are not walked, so the release is O(slabs), not O(nnz).
+
+  A matrix owns its rows, its CSR and its pool, and shares the maps of its vectors: it can be
+  moved, e.g. out of a function, but not copied*/
+template<typename T, typename S, typename R = std::map<S,T> >
 class parMatrixSparse
 {
 
 	private:
-		std::map<S, T> *dynmat_lloc, *dynmat_gloc;
+		R *dynmat_lloc, *dynmat_gloc;
 
 		//size of local matrix
 		S	ncols, nrows;
 
 		S	nnz_lloc, nnz_gloc, nnz_loc;
 
-		parVectorMap<S>	*x_index_map;
-		parVectorMap<S>	*y_index_map;
+		std::shared_ptr<parVectorMap<S> >	x_index_map;
+		std::shared_ptr<parVectorMap<S> >	y_index_map;
 
 		S	njloc;
 		S	lower_x, lower_y, upper_x, upper_y;
@@ -65,18 +87,31 @@ class parMatrixSparse
 		// mpi size and rank
 		int ProcID, nProcs;
 
-		// pointers and buffers for setting up communications
-		S	*VNumRecv, *VNumSend;
-		S	maxRecv, maxSend;
-		S	**Rbuffer, **Sbuffer;
+		//pool of the nodes of the rows, only for the pooled rows
+		rowPool	*pool;
+
+		//new local rows, bound to the pool of the matrix
+		R	*NewRows();
+		void	DeleteRows(R *rows);
+
+		//exact size CSR of the rows, in two passes, with the values converted to V
+		template<typename O, typename V>
+		MatrixCSR<V,S,O>	*RowsToCSR(R *rows, bool nonzeros);
 
-		MPI_Datatype *DTypeRecv , *DTypeSend ;
+		//row <- a*row + b*xrow, merge of two sorted rows, see Loc_MatAXPY
+		S	Loc_MergeRow(R &row, R &xrow, T a, T b);
+
+		//exchange of all the members, see the move constructor and assignment
+		void	Swap(parMatrixSparse<T,S,R> &X);
+
+		//plan of the distributed SpMV on CSR_loc, see GetSpMVPlan
+		std::unique_ptr<spmvPlan<T,S> >	spmv_plan;
 
 	public:
 
-		MatrixCSR<T,S> *CSR_lloc, *CSR_gloc, *CSR_loc;
+		std::unique_ptr<MatrixCSR<T,S> > CSR_lloc, CSR_gloc, CSR_loc;
 
-		std::map<S, T> *dynmat_loc;
+		R *dynmat_loc;
 
 		//constructor
 		parMatrixSparse();
@@ -85,9 +120,15 @@ class parMatrixSparse
 		//deconstructor
 		~parMatrixSparse();
 
+		//move only, the moved matrix is left empty
+		parMatrixSparse(parMatrixSparse<T,S,R> &&X);
+		parMatrixSparse<T,S,R> &operator=(parMatrixSparse<T,S,R> &&X);
+		parMatrixSparse(const parMatrixSparse<T,S,R> &) = delete;
+		parMatrixSparse<T,S,R> &operator=(const parMatrixSparse<T,S,R> &) = delete;
+
 		//get
-		parVectorMap<S> *GetXMap(){return x_index_map;};
-		parVectorMap<S> *GetYMap(){return y_index_map;};
+		parVectorMap<S> *GetXMap(){return x_index_map.get();};
+		parVectorMap<S> *GetYMap(){return y_index_map.get();};
 
 		MPI_Comm GetComm(){
 			return x_index_map->GetCurrentComm();
@@ -108,13 +149,15 @@ class parMatrixSparse
 			cs = ncols;
 		};
 
-		std::map<S,T>	*GetDynMatGLobLoc(){return dynmat_lloc;};
-		std::map<S,T>	*GetDynMatGlobLoc(){return dynmat_gloc;};
+		S	GetLocNnz(){return nnz_loc;};
+
+		R	*GetDynMatGLobLoc(){return dynmat_lloc;};
+		R	*GetDynMatGlobLoc(){return dynmat_gloc;};
 
-		std::map<S,T>	*GetDynMatLoc(){return dynmat_loc;};
+		R	*GetDynMatLoc(){return dynmat_loc;};
 
-		MatrixCSR<T,S>	*GetCSRLocLoc(){return CSR_lloc;};
-		MatrixCSR<T,S>	*GetCSRGlobLoc(){return CSR_gloc;};
+		MatrixCSR<T,S>	*GetCSRLocLoc(){return CSR_lloc.get();};
+		MatrixCSR<T,S>	*GetCSRGlobLoc(){return CSR_gloc.get();};
 
 		//add
 		void	AddValueLocal( S row, S col, T value);
@@ -150,6 +193,9 @@ class parMatrixSparse
 		void	Loc_SetValueLocal( S row, S col, T value);
   	void 	Loc_SetValuesLocal( S nindex, S *rows, S *cols, T *values);
 
+		//LOC set a whole local row at once, cols should be given in increasing order
+		void	Loc_SetRowLocal( S row, S ncols_row, S *cols, T *values);
+
 		//LOC global set
 		void	Loc_SetValue(S row, S col, T value);
 
@@ -173,46 +219,84 @@ class parMatrixSparse
 		//Loc Mat Scale
 		void	Loc_MatScale(T scale);
 
-		//Loc AXPY
-		void	Loc_MatAXPY(parMatrixSparse<T,S> *X, T scale);
+		//Loc AXPY: this <- this + scale*X, X is not modified
+		void	Loc_MatAXPY(parMatrixSparse<T,S,R> *X, T scale);
 
-		//Loc AYPX
-		void    Loc_MatAYPX(parMatrixSparse<T,S> *X, T scale);
+		//Loc AYPX: this <- scale*this + X, X is not modified
+		void    Loc_MatAYPX(parMatrixSparse<T,S,R> *X, T scale);
 
 
 		// convert from dyn to csr
 		void	ConvertToCSR();
 
-		// convert from dyn to csr
+		// convert from dyn to csr, with the offsets of type S: CSR_loc is left empty, with an error,
+		// for more local nnz than S can hold
 		void	Loc_ConvertToCSR();
 
+		// new CSR of the local rows without the zeros, with the row offsets of type O (e.g. int64_t
+		// for more than 2^31 local nnz with S = int), see RowsToCSR. The values are rounded to V at
+		// the emission, e.g. float for a matrix generated in double, see smg2s_mixed()
+		template<typename O, typename V = T>
+		MatrixCSR<V,S,O>	*Loc_AssembleCSR();
+
+		// read the entries of the local rows from a Matrix Market file (coordinate, general or
+		// symmetric), into the LOC rows
+		void	ReadExtMat(std::string file);
+
+		// plan of the distributed SpMV on CSR_loc, see spmvPlan.h, built at the first call (collective),
+		// with CSR_loc if needed, and again after each Loc_ConvertToCSR. It can be used on its own to
+		// overlap other work with the exchange of the ghosts: Begin(x), Interior(y), End(y)
+		spmvPlan<T,S>	*GetSpMVPlan();
+
+		// SpMV setup, collective: the cols of CSR_loc owned by the other procs (ghosts), and the
+		// entries of x to send to each proc, i.e. a new plan
+		void	FindColsToRecv();
+
+		// SpMV setup: the exchange of the ghosts, reused at each product, with the mode of the plan
+		// (persistent requests by default, see spmvCommMode)
+		void	SetupDataTypes();
+
+		// y = this * x on CSR_loc, with the exchange of the ghosts of x overlapped with the interior
+		// rows, collective
+		void	CSR_MatVecProd(parVector<T,S> *x, parVector<T,S> *y);
+
+		// Y = this * X for the k vectors of X on CSR_loc, each row of CSR_loc being read once for
+		// the k vectors and the k entries of a ghost sent together, collective
+		void	CSR_MatMultiVecProd(parMultiVector<T,S> *X, parMultiVector<T,S> *Y);
+
+		// number of ghost entries of x received at each CSR_MatVecProd
+		S	GetNumGhosts(){return GetSpMVPlan()->GetNumGhosts();};
+
 		// Zeros all entries with keeping the previous matrix pattern
 		void	ZeroEntries();
 
 		// Loc: Zeros all entries with keeping the previous matrix pattern
 		void	Loc_ZeroEntries();
 
+		// Loc: remove the entries with |value| <= tol, the explicit zeros for tol = 0, returns the number removed
+		S	Loc_Prune(double tol = 0);
+
+
    	//matrix multiple a special nilpotent matrix
-		void	MA(Nilpotency<S> nilp, parMatrixSparse<T,S> *prod);
+		void	MA(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *prod);
 
 		//special nilpotent matrix multiple another matrix
-		void	AM(Nilpotency<S> nilp, parMatrixSparse<T,S> *prod);
+		void	AM(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *prod);
+
+		//fused kernel: this <- AM - MA and acc <- acc + scale * this, in one sweep of the rows
+		void	FusedAMMA(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *acc, T scale);
 
 
 };
 
 
-template<typename T, typename S>
-parMatrixSparse<T,S>::parMatrixSparse()
+template<typename T, typename S, typename R>
+parMatrixSparse<T,S,R>::parMatrixSparse()
 {
 	dynmat_lloc = NULL;
 	dynmat_gloc = NULL;
 	dynmat_loc  = NULL;
 
-	CSR_lloc = NULL;
-	CSR_gloc = NULL;
-	CSR_loc = NULL;
-
 	nnz_lloc = 0;
 	nnz_gloc = 0;
 	nnz_loc = 0;
@@ -226,38 +310,24 @@ parMatrixSparse<T,S>::parMatrixSparse()
 	upper_x = 0;
 	upper_y = 0;
 
-	x_index_map = NULL;
-	y_index_map = NULL;
+	comm = MPI_COMM_NULL;
+	ProcID = 0;
+	nProcs = 1;
 
-//	MPI_Comm_rank(MPI_COMM_WORLD, &ProcID);
-//	MPI_Comm_size(MPI_COMM_WORLD, &nProcs);
-
-	VNumRecv = NULL;
-	VNumSend = NULL;
-	Rbuffer = NULL;
-	Sbuffer = NULL;
-	DTypeRecv = NULL;
-	DTypeSend = NULL;
+	pool = NULL;
 }
 
-template<typename T, typename S>
-parMatrixSparse<T,S>::parMatrixSparse(parVector<T,S> *XVec, parVector<T,S> *YVec)
+template<typename T, typename S, typename R>
+parMatrixSparse<T,S,R>::parMatrixSparse(parVector<T,S> *XVec, parVector<T,S> *YVec)
 {
 	dynmat_lloc = NULL;
 	dynmat_gloc = NULL;
 	dynmat_loc  = NULL;
 
-	CSR_lloc = NULL;
-	CSR_gloc = NULL;
-    CSR_loc = NULL;
-
 	nnz_lloc = 0;
 	nnz_gloc = 0;
 	nnz_loc  = 0;
 
-	x_index_map = NULL;
-	y_index_map = NULL;
-
 	ncols = 0;
 	nrows = 0;
 	njloc = 0;
@@ -268,19 +338,11 @@ parMatrixSparse<T,S>::parMatrixSparse(parVector<T,S> *XVec, parVector<T,S> *YVec
 	upper_x = 0;
 	upper_y = 0;
 
-	VNumRecv = NULL;
-	VNumSend = NULL;
-	Rbuffer = NULL;
-	Sbuffer = NULL;
-
-	DTypeRecv = NULL;
-	DTypeSend = NULL;
+	pool = NULL;
 
-	//get vector map for x and y direction
-	x_index_map = XVec->GetVecMap();
-	x_index_map->AddUser();
-	y_index_map = YVec->GetVecMap();
-	y_index_map->AddUser();
+	//get vector map for x and y direction, shared with the vectors
+	x_index_map = XVec->ShareVecMap();
+	y_index_map = YVec->ShareVecMap();
 
 	if(x_index_map != NULL && y_index_map != NULL){
 		//get num of rows and cols in this mpi procs
@@ -302,84 +364,120 @@ parMatrixSparse<T,S>::parMatrixSparse(parVector<T,S> *XVec, parVector<T,S> *YVec
 
 }
 
-template<typename T, typename S>
-parMatrixSparse<T,S>::~parMatrixSparse()
+template<typename T, typename S, typename R>
+parMatrixSparse<T,S,R>::~parMatrixSparse()
 {
-	//if index map is defined
-	if(x_index_map != NULL){
-		x_index_map->DeleteUser();
-
-//		if(x_index_map->GetUser() == 0){
-			delete x_index_map;
-//		}
-	}
-
-
-	if(y_index_map != NULL){
-		y_index_map->DeleteUser();
-
-//		if(x_index_map->GetUser() == 0){
-			delete y_index_map;
-//		}
-	}
+	//the maps are released with the last matrix or vector sharing them, the CSR with the matrix
 
 	//if dynmat has been defined
 	if(dynmat_lloc != NULL){
-		delete [] dynmat_lloc;
+		DeleteRows(dynmat_lloc);
 	}
 	if(dynmat_gloc != NULL){
-		delete [] dynmat_gloc;
-	}
-	if(CSR_lloc != NULL){
-		delete [] CSR_lloc;
+		DeleteRows(dynmat_gloc);
 	}
-	if(CSR_gloc != NULL){
-		delete [] CSR_gloc;
-	}
-	if(CSR_gloc != NULL){
-		delete [] CSR_loc;
+	if(dynmat_loc != NULL){
+		DeleteRows(dynmat_loc);
 	}
-	if(VNumRecv != NULL){
-		delete [] VNumRecv;
+
+	//after the rows: the nodes of the pooled rows are given back with the slabs
+	if(pool != NULL){
+		delete pool;
 	}
-	if(VNumSend != NULL){
-		delete [] VNumSend;
+}
+
+template<typename T, typename S, typename R>
+parMatrixSparse<T,S,R>::parMatrixSparse(parMatrixSparse<T,S,R> &&X) : parMatrixSparse()
+{
+	Swap(X);
+}
+
+template<typename T, typename S, typename R>
+parMatrixSparse<T,S,R> &parMatrixSparse<T,S,R>::operator=(parMatrixSparse<T,S,R> &&X)
+{
+	//the former rows are released by tmp, before its pool
+	parMatrixSparse<T,S,R> tmp(std::move(X));
+
+	Swap(tmp);
+
+	return *this;
+}
+
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Swap(parMatrixSparse<T,S,R> &X)
+{
+	std::swap(dynmat_lloc, X.dynmat_lloc);
+	std::swap(dynmat_gloc, X.dynmat_gloc);
+	std::swap(dynmat_loc, X.dynmat_loc);
+
+	std::swap(ncols, X.ncols);
+	std::swap(nrows, X.nrows);
+	std::swap(nnz_lloc, X.nnz_lloc);
+	std::swap(nnz_gloc, X.nnz_gloc);
+	std::swap(nnz_loc, X.nnz_loc);
+
+	x_index_map.swap(X.x_index_map);
+	y_index_map.swap(X.y_index_map);
+
+	std::swap(njloc, X.njloc);
+	std::swap(lower_x, X.lower_x);
+	std::swap(lower_y, X.lower_y);
+	std::swap(upper_x, X.upper_x);
+	std::swap(upper_y, X.upper_y);
+
+	std::swap(comm, X.comm);
+	std::swap(ProcID, X.ProcID);
+	std::swap(nProcs, X.nProcs);
+
+	//the pooled rows keep pointing to their pool, which moves with them
+	std::swap(pool, X.pool);
+
+	CSR_lloc.swap(X.CSR_lloc);
+	CSR_gloc.swap(X.CSR_gloc);
+	CSR_loc.swap(X.CSR_loc);
+
+	spmv_plan.swap(X.spmv_plan);
+}
+
+template<typename T, typename S, typename R>
+R *parMatrixSparse<T,S,R>::NewRows()
+{
+	if(rowBinder<R>::pooled && pool == NULL){
+		pool = new rowPool();
 	}
-	if(Rbuffer != NULL){
-		int i;
-		for(i = 0; i < nProcs; i++){
-			if (Rbuffer[i] != NULL){
-				delete [] Rbuffer[i];
-			}
-		}
-		delete [] Rbuffer;
+
+	//raw storage, so that DeleteRows can release the rows without running their destructors
+	R *rows = (R *)::operator new(nrows*sizeof(R));
+
+	for(S i = 0; i < nrows; i++){
+		new (&rows[i]) R();
 	}
 
-	if(Sbuffer != NULL){
-		int i;
-	        for(i = 0; i < nProcs; i++){
-                        if (Sbuffer[i] != NULL){
-                                delete [] Sbuffer[i];
-                        }
-                }
-                delete [] Sbuffer;
+	if(pool != NULL){
+		for(S i = 0; i < nrows; i++){
+			rowBinder<R>::Bind(rows[i], pool);
+		}
 	}
 
+	return rows;
+}
 
-	if(DTypeRecv != NULL){
-		int i;
-		for(i = 0; i < nProcs; i++){
-			if(DTypeSend[i] != MPI_DATATYPE_NULL){
-				MPI_Type_free(&DTypeSend[i]);
-			}
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::DeleteRows(R *rows)
+{
+	//the dropped rows keep their nodes, which are given back with the slabs when the pool is deleted
+	if(!rowBinder<R>::dropped){
+		for(S i = 0; i < nrows; i++){
+			rows[i].~R();
 		}
-		delete [] DTypeSend;
 	}
+
+	::operator delete(rows);
 }
 
 
-template<typename T, typename S>
-S parMatrixSparse<T,S>::GetXLowerBound(){
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::GetXLowerBound(){
 	if(x_index_map != NULL){
 		return x_index_map->GetLowerBound();
 	}
@@ -388,8 +486,8 @@ S parMatrixSparse<T,S>::GetXLowerBound(){
 	}
 }
 
-template<typename T, typename S>
-S parMatrixSparse<T,S>::GetXUpperBound(){
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::GetXUpperBound(){
         if(x_index_map != NULL){
                 return x_index_map->GetUpperBound();
         }
@@ -398,8 +496,8 @@ S parMatrixSparse<T,S>::GetXUpperBound(){
         }
 }
 
-template<typename T,typename S>
-S parMatrixSparse<T,S>::GetYLowerBound(){
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::GetYLowerBound(){
         if(y_index_map != NULL){
                 return y_index_map->GetLowerBound();
         }
@@ -408,8 +506,8 @@ S parMatrixSparse<T,S>::GetYLowerBound(){
         }
 }
 
-template<typename T, typename S>
-S parMatrixSparse<T,S>::GetYUpperBound(){
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::GetYUpperBound(){
         if(y_index_map != NULL){
                 return y_index_map->GetUpperBound();
         }
@@ -418,14 +516,14 @@ S parMatrixSparse<T,S>::GetYUpperBound(){
         }
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::AddValueLocal(S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::AddValueLocal(S row, S col, T value)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 	//if location is inside of local area then add to local dynamic map
 	if((row < nrows && row >= 0) && (col < upper_x && col >= lower_x && col >= 0)){
 		if(dynmat_lloc == NULL){
-			dynmat_lloc = new std::map<S,T> [nrows];
+			dynmat_lloc = NewRows();
 		}
 		it = dynmat_lloc[row].find(col);
 		if(it == dynmat_lloc[row].end()){
@@ -439,7 +537,7 @@ void parMatrixSparse<T,S>::AddValueLocal(S row, S col, T value)
 	}
 	else if ((row < nrows && row >= 0) && (col >= upper_x || col < lower_x) && (col >= 0)){
 		if(dynmat_gloc == NULL){
-			dynmat_gloc = new std::map<S,T> [nrows];
+			dynmat_gloc = NewRows();
 		}
 		it = dynmat_gloc[row].find(col);
 		if(it == dynmat_gloc[row].end()){
@@ -452,8 +550,8 @@ void parMatrixSparse<T,S>::AddValueLocal(S row, S col, T value)
 	}
 }
 
-template<typename T,typename S>
-T parMatrixSparse<T,S>::GetLocalValue(S row, S col)
+template<typename T, typename S, typename R>
+T parMatrixSparse<T,S,R>::GetLocalValue(S row, S col)
 {
 	if((row < nrows && row >= 0) && (col < upper_x && col >= lower_x && col >= 0)){
 		return dynmat_lloc[row][col];
@@ -464,18 +562,18 @@ T parMatrixSparse<T,S>::GetLocalValue(S row, S col)
 	else return 0.0;
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::AddValuesLocal(S nindex, S *rows, S *cols, T *values)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::AddValuesLocal(S nindex, S *rows, S *cols, T *values)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	for( S i = 0; i < nindex; i++){
 		AddValueLocal(rows[i],cols[i],values[i]);
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::AddValue(S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::AddValue(S row, S col, T value)
 {
 
 	if((row >= lower_y) && (row < upper_y) && (col < ncols)){
@@ -484,14 +582,14 @@ void parMatrixSparse<T,S>::AddValue(S row, S col, T value)
 }
 
 //set
-template<typename T,typename S>
-void parMatrixSparse<T,S>::SetValueLocal( S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::SetValueLocal( S row, S col, T value)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 	//if location is inside of local area then add to local dynamic map
 	if((row < nrows && row >= 0) && (col < upper_x && col >= lower_x && col >= 0)){
 		if(dynmat_lloc == NULL){
-			dynmat_lloc = new std::map<S,T> [nrows];
+			dynmat_lloc = NewRows();
 		}
 		it = dynmat_lloc[row].find(col);
 		if(it == dynmat_lloc[row].end()){
@@ -506,7 +604,7 @@ void parMatrixSparse<T,S>::SetValueLocal( S row, S col, T value)
 	}
 	else if ((row < nrows && row >= 0) && (col >= upper_x || col < lower_x) && (col >= 0)){
 		if(dynmat_gloc == NULL){
-			dynmat_gloc = new std::map<S,T> [nrows];
+			dynmat_gloc = NewRows();
 		}
 		it = dynmat_gloc[row].find(col);
 		if(it == dynmat_gloc[row].end()){
@@ -520,10 +618,10 @@ void parMatrixSparse<T,S>::SetValueLocal( S row, S col, T value)
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::SetValuesLocal( S nindex, S *rows, S *cols, T *values)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::SetValuesLocal( S nindex, S *rows, S *cols, T *values)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	for( S i = 0; i < nindex; i++){
 		SetValueLocal(rows[i],cols[i],values[i]);
@@ -531,8 +629,8 @@ void parMatrixSparse<T,S>::SetValuesLocal( S nindex, S *rows, S *cols, T *values
 }
 
 //global set
-template<typename T,typename S>
-void parMatrixSparse<T,S>::SetValue(S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::SetValue(S row, S col, T value)
 {
 	S local_row = y_index_map->Glob2Loc(row);
 
@@ -542,8 +640,8 @@ void parMatrixSparse<T,S>::SetValue(S row, S col, T value)
 }
 
 
-template<typename T,typename S>
-T parMatrixSparse<T,S>::GetValue(S row, S col)
+template<typename T, typename S, typename R>
+T parMatrixSparse<T,S,R>::GetValue(S row, S col)
 {
 	S local_row = y_index_map->Glob2Loc(row);
 	if(local_row >= 0 && local_row < nrows){
@@ -554,16 +652,16 @@ T parMatrixSparse<T,S>::GetValue(S row, S col)
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::glocPlusLloc(){
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::glocPlusLloc(){
 
 	S i;
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	if(ProcID == 0) {std::cout << "Combine the block-diagonal part and non block-diagonal part of parallel matrix together " << std::endl;}
 
 	if(dynmat_loc == NULL){
-		dynmat_loc = new std::map<S, T> [nrows];
+		dynmat_loc = NewRows();
 	}
 	for(i = 0; i < nrows; i++){
 		if((dynmat_gloc != NULL) && (dynmat_lloc != NULL)){
@@ -584,20 +682,20 @@ void parMatrixSparse<T,S>::glocPlusLloc(){
 
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::llocToGlocLoc()
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::llocToGlocLoc()
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	S col;
 
 	//if location is inside of local area then add to local dynamic map
 	if(dynmat_loc != NULL){
 		if(dynmat_lloc == NULL){
-			dynmat_lloc = new std::map<S,T> [nrows];
+			dynmat_lloc = NewRows();
 		}
 		if(dynmat_gloc == NULL){
-			dynmat_gloc = new std::map<S,T> [nrows];
+			dynmat_gloc = NewRows();
 		}
 
 		for(S i = 0; i < nrows; i++){
@@ -614,16 +712,16 @@ void parMatrixSparse<T,S>::llocToGlocLoc()
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::MatView(){
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::MatView(){
 
 	S i;
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	if(ProcID == 0) {std::cout << "Parallel MatView: " << std::endl;}
 
 	for (i = 0; i < nrows; i++){
-		std::map<S,T> merge;
+		R merge;
 		std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
 
 		if((dynmat_gloc != NULL) && (dynmat_lloc != NULL)){
@@ -650,138 +748,11 @@ void parMatrixSparse<T,S>::MatView(){
 	}
 }
 
-template<>
-void parMatrixSparse<std::complex<double>, int>::LOC_MatView(){
-
-	int i;
-	typename std::map<int,std::complex<double>>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second.real() != 0 || it->second.imag() != 0){
-					std::cout <<"("<<it->first << "," << it->second << "); ";
-				}	
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-template<>
-void parMatrixSparse<std::complex<double>, __int64_t>::LOC_MatView(){
-
-	__int64_t i;
-	typename std::map<__int64_t,std::complex<double>>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second.real() != 0 || it->second.imag() != 0){
-					std::cout <<"("<<it->first << "," << it->second << "); ";
-				}	
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-template<>
-void parMatrixSparse<std::complex<float>, int>::LOC_MatView(){
-
-	int i;
-	typename std::map<int,std::complex<float>>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second.real() != 0 || it->second.imag() != 0){
-					std::cout <<"("<<it->first << "," << it->second << "); ";
-				}	
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-template<>
-void parMatrixSparse<std::complex<float>, __int64_t>::LOC_MatView(){
-
-	__int64_t i;
-	typename std::map<__int64_t,std::complex<float>>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second.real() != 0 || it->second.imag() != 0){
-					std::cout <<"("<<it->first << "," << it->second << "); ";
-				}	
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-template<>
-void parMatrixSparse<double, int>::LOC_MatView(){
-
-	int i;
-	typename std::map<int,double>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second != 0){
-					std::cout <<"("<<it->first << "," << it->second << "); ";
-				}	
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-template<>
-void parMatrixSparse<double, __int64_t>::LOC_MatView(){
-
-	__int64_t i;
-	typename std::map<__int64_t,double>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second != 0){
-						std::cout <<"("<<it->first << "," << it->second << "); ";
-				}
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::LOC_MatView(){
 
-template<>
-void parMatrixSparse<float, int>::LOC_MatView(){
-
-	int i;
-	typename std::map<int,float>::iterator it;
+	S i;
+	typename R::iterator it;
 
 	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
 
@@ -789,7 +760,7 @@ void parMatrixSparse<float, int>::LOC_MatView(){
 		if(dynmat_loc != NULL){
 			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
 			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second != 0){
+				if(it->second != T(0)){
 					std::cout <<"("<<it->first << "," << it->second << "); ";
 				}	
 			}
@@ -798,36 +769,14 @@ void parMatrixSparse<float, int>::LOC_MatView(){
 	}
 }
 
-template<>
-void parMatrixSparse<float, __int64_t>::LOC_MatView(){
-
-	__int64_t i;
-	typename std::map<__int64_t,float>::iterator it;
-
-	if(ProcID == 0) {std::cout << "LOC MODE Parallel MatView: " << std::endl;}
-
-	for (i = 0; i < nrows; i++){
-		if(dynmat_loc != NULL){
-			std::cout << "row " << y_index_map->Loc2Glob(i) << ": ";
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
-				if(it->second != 0){
-						std::cout <<"("<<it->first << "," << it->second << "); ";
-				}
-			}
-		}
-	std::cout << std::endl;
-	}
-}
-
-
 //Loc set
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_SetValueLocal( S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetValueLocal( S row, S col, T value)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	if(dynmat_loc == NULL){
-		dynmat_loc = new std::map<S,T> [nrows];
+		dynmat_loc = NewRows();
 	}
 	it = dynmat_loc[row].find(col);
 
@@ -840,19 +789,46 @@ void parMatrixSparse<T,S>::Loc_SetValueLocal( S row, S col, T value)
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_SetValuesLocal( S nindex, S *rows, S *cols, T *values)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetValuesLocal( S nindex, S *rows, S *cols, T *values)
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	for( S i = 0; i < nindex; i++){
 		Loc_SetValueLocal(rows[i],cols[i],values[i]);
 	}
 }
 
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetRowLocal( S row, S ncols_row, S *cols, T *values)
+{
+	typename R::iterator it;
+	S	size_row;
+
+	if(row < 0 || row >= nrows){
+		return;
+	}
+
+	if(dynmat_loc == NULL){
+		dynmat_loc = NewRows();
+	}
+
+	//the cols are sorted, so each new entry is appended with the end() hint in amortized O(1)
+	for(S k = 0; k < ncols_row; k++){
+		size_row = dynmat_loc[row].size();
+		it = dynmat_loc[row].insert(dynmat_loc[row].end(), std::make_pair(cols[k], values[k]));
+		if(S(dynmat_loc[row].size()) == size_row){
+			it->second = values[k];
+		}
+		else{
+			nnz_loc++;
+		}
+	}
+}
+
 //Loc global set
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_SetValue(S row, S col, T value)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetValue(S row, S col, T value)
 {
 	S local_row = y_index_map->Glob2Loc(row);
 
@@ -862,8 +838,8 @@ void parMatrixSparse<T,S>::Loc_SetValue(S row, S col, T value)
 
 }
 
-template<typename T,typename S>
-T parMatrixSparse<T,S>::Loc_GetLocalValue(S row, S col)
+template<typename T, typename S, typename R>
+T parMatrixSparse<T,S,R>::Loc_GetLocalValue(S row, S col)
 {
 	if(dynmat_loc != NULL){
 		return dynmat_loc[row][col];
@@ -872,8 +848,8 @@ T parMatrixSparse<T,S>::Loc_GetLocalValue(S row, S col)
 }
 
 
-template<typename T,typename S>
-T parMatrixSparse<T,S>::Loc_GetValue(S row, S col)
+template<typename T, typename S, typename R>
+T parMatrixSparse<T,S,R>::Loc_GetValue(S row, S col)
 {
 	S local_row = y_index_map->Glob2Loc(row);
 	if(local_row >= 0 && local_row < nrows){
@@ -886,8 +862,8 @@ T parMatrixSparse<T,S>::Loc_GetValue(S row, S col)
 
 
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::SetDiagonal(parVector<T,S> *diag)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::SetDiagonal(parVector<T,S> *diag)
 {
 
 	if (nrows != njloc ){
@@ -907,8 +883,8 @@ void parMatrixSparse<T,S>::SetDiagonal(parVector<T,S> *diag)
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_SetDiagonal(parVector<T,S> *diag)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetDiagonal(parVector<T,S> *diag)
 {
 
 	if (nrows != njloc ){
@@ -929,8 +905,8 @@ void parMatrixSparse<T,S>::Loc_SetDiagonal(parVector<T,S> *diag)
 }
 
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_SetDiagonal_index(parVector<T,S> *diag, S index)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_SetDiagonal_index(parVector<T,S> *diag, S index)
 {
 
 	if (nrows != njloc ){
@@ -959,378 +935,195 @@ void parMatrixSparse<T,S>::Loc_SetDiagonal_index(parVector<T,S> *diag, S index)
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::ConvertToCSR()
-{
-	S 	count, i, j;
-	T	v;
-	typename std::map<S,T>::iterator it;
-
-	if(dynmat_lloc != NULL){
-		//allocate csr matrix
+/*Two-pass assembly of rows into a CSR of the exact size: the entries of each row are counted
+  first, their prefix sums in the offset type O give the row offsets, then the cols and vals are
+  filled in place. Both passes are independent from row to row. With nonzeros, the explicit
+  zeros are skipped, after the conversion to V: the entries which underflow in V are dropped too.
+  If the offsets overflow O, an error is printed and the CSR is empty*/
+template<typename T, typename S, typename R>
+template<typename O, typename V>
+MatrixCSR<V,S,O> *parMatrixSparse<T,S,R>::RowsToCSR(R *rows, bool nonzeros){
+	S	i;
+	O	cnt, pos;
 
+	typename R::iterator it;
 
-		CSR_lloc = new MatrixCSR<T,S>(nnz_lloc, nrows);
+	MatrixCSR<V,S,O> *csr = new MatrixCSR<V,S,O>(0, nrows);
 
-//		CSR_lloc = new MatrixCSR<T,S>(nrows);
+	csr->rows.assign(nrows + 1, O(0));
 
-		//convert local local to csr
-		count = 0;
-		//CSR_lloc->rows.push_back(0);
+	if(rows == NULL){
+		return csr;
+	}
 
-		for(i = 0; i < nrows; i++){
-			CSR_lloc->rows.push_back(count);
-			for(it = dynmat_lloc[i].begin(); it != dynmat_lloc[i].end(); it++){
-				j = it->first;
-				v = it->second;
-				CSR_lloc->vals.push_back(v);
-				CSR_lloc->cols.push_back(j);
-				count++;
+	//pass 1: size of each row
+#ifdef _OPENMP
+#pragma omp parallel for private(it, cnt) schedule(static)
+#endif
+	for(i = 0; i < nrows; i++){
+		cnt = 0;
+		for(it = rows[i].begin(); it != rows[i].end(); ++it){
+			if(!nonzeros || V(it->second) != V(0)){
+				cnt++;
 			}
 		}
-		CSR_lloc->rows.push_back(nnz_lloc);
+		csr->rows[i + 1] = cnt;
 	}
 
-	if(dynmat_gloc != NULL){
-
+	for(i = 0; i < nrows; i++){
+		//the local nnz do not fit in O, e.g. more than 2^31 - 1 in CSR_loc with S = int: no wrap around
+		if(csr->rows[i + 1] > std::numeric_limits<O>::max() - csr->rows[i]){
+			printf("ERROR ]> Proc %d: the local nnz exceed %lld, the largest row offset of the CSR, which is left empty. Use Loc_AssembleCSR with 64-bit offsets\n", ProcID, (long long)std::numeric_limits<O>::max());
+			csr->rows.assign(nrows + 1, O(0));
+			return csr;
+		}
+		csr->rows[i + 1] += csr->rows[i];
+	}
 
-		CSR_gloc = new MatrixCSR<T,S>(nnz_gloc, nrows);
-//		CSR_gloc = new MatrixCSR<T,S>(nrows);
+	csr->nnz = csr->rows[nrows];
+	csr->cols.resize(csr->nnz);
+	csr->vals.resize(csr->nnz);
 
-		//convert global-local to CSR
-		count = 0;
-		//CSR_gloc->rows.push_back(0);
-		for(i = 0; i < nrows; i++){
-			CSR_gloc->rows.push_back(count);
-			for(it = dynmat_gloc[i].begin(); it != dynmat_gloc[i].end(); it++){
-				j = it->first;
-				v = it->second;
-				CSR_gloc->vals.push_back(v);
-				CSR_gloc->cols.push_back(j);
-				count++;
+	//pass 2: each row is filled at its offset
+#ifdef _OPENMP
+#pragma omp parallel for private(it, pos) schedule(static)
+#endif
+	for(i = 0; i < nrows; i++){
+		pos = csr->rows[i];
+		for(it = rows[i].begin(); it != rows[i].end(); ++it){
+			if(!nonzeros || V(it->second) != V(0)){
+				csr->cols[pos] = it->first;
+				csr->vals[pos] = V(it->second);
+				pos++;
 			}
 		}
-		CSR_gloc->rows.push_back(nnz_gloc);
 	}
-}
-
-template<>
-void parMatrixSparse<std::complex<double>, int>::Loc_ConvertToCSR(){
-	int 	count, i, j;
-	std::complex<double>	v;
 
-	typename std::map<int,std::complex<double>>::iterator it;
-
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<std::complex<double>,int>(nnz_loc, nrows);
+	return csr;
+}
 
-		count = 0;
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::ConvertToCSR()
+{
+	if(dynmat_lloc != NULL){
+		CSR_lloc.reset(RowsToCSR<S,T>(dynmat_lloc, false));
+	}
 
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second.imag() != 0 || it->second.real() != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
-		}
-		CSR_loc->rows.push_back(count);
+	if(dynmat_gloc != NULL){
+		CSR_gloc.reset(RowsToCSR<S,T>(dynmat_gloc, false));
 	}
 }
 
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_ConvertToCSR(){
 
-template<>
-void parMatrixSparse<std::complex<double>, __int64_t>::Loc_ConvertToCSR(){
-	__int64_t 	count, i, j;
-	std::complex<double>	v;
+	if(dynmat_loc != NULL){
+		CSR_loc.reset(RowsToCSR<S,T>(dynmat_loc, true));
+	}
 
-	typename std::map<__int64_t,std::complex<double>>::iterator it;
+	//the SpMV plan was built on the former CSR_loc
+	spmv_plan.reset();
+}
 
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
+template<typename T, typename S, typename R>
+template<typename O, typename V>
+MatrixCSR<V,S,O> *parMatrixSparse<T,S,R>::Loc_AssembleCSR(){
+	return RowsToCSR<O,V>(dynmat_loc, true);
+}
 
-		CSR_loc = new MatrixCSR<std::complex<double>,__int64_t>(nnz_loc, nrows);
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::MatScale(T scale){
+	typename R::iterator it;
 
-		count = 0;
+	S i;
 
+	if(dynmat_lloc != NULL){
 		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second.imag() != 0 || it->second.real() != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
+			for(it = dynmat_lloc[i].begin(); it != dynmat_lloc[i].end(); it++){
+				it->second = it->second*scale;
 			}
 		}
-		CSR_loc->rows.push_back(count);
 	}
-}
-
-
-template<>
-void parMatrixSparse<std::complex<float>, int>::Loc_ConvertToCSR(){
-	int 	count, i, j;
-	std::complex<float>	v;
-
-	typename std::map<int,std::complex<float>>::iterator it;
-
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<std::complex<float>,int>(nnz_loc, nrows);
-
-		count = 0;
 
+	if(dynmat_gloc != NULL){
 		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second.imag() != 0 || it->second.real() != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
+			for(it = dynmat_gloc[i].begin(); it != dynmat_gloc[i].end(); it++){
+				it->second = it->second*scale;
 			}
 		}
-		CSR_loc->rows.push_back(count);
 	}
 }
 
-template<>
-void parMatrixSparse<std::complex<float>, __int64_t>::Loc_ConvertToCSR(){
-	__int64_t 	count, i, j;
-	std::complex<float>	v;
-
-	typename std::map<__int64_t,std::complex<float>>::iterator it;
+/*row <- a*row + b*xrow in one two-pointer sweep of both rows, sorted by col. The entries of xrow
+  missing in row are inserted at the current position, which is the only allocation, and xrow is
+  only read. Returns the number of entries inserted*/
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::Loc_MergeRow(R &row, R &xrow, T a, T b){
 
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
+	typename R::iterator it, itx;
 
-		CSR_loc = new MatrixCSR<std::complex<float>,__int64_t>(nnz_loc, nrows);
+	S added = 0;
 
-		count = 0;
+	it = row.begin();
 
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second.imag() != 0 || it->second.real() != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
+	for(itx = xrow.begin(); itx != xrow.end(); ++itx){
+		while(it != row.end() && it->first < itx->first){
+			it->second = a*it->second;
+			++it;
 		}
-		CSR_loc->rows.push_back(count);
-	}
-}
-
-
-
-
-template<>
-void parMatrixSparse<double, int>::Loc_ConvertToCSR(){
-	int 	count, i, j;
-	double	v;
-
-	typename std::map<int,double>::iterator it;
-
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<double,int>(nnz_loc, nrows);
-
-		count = 0;
-
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
+		if(it != row.end() && it->first == itx->first){
+			it->second = a*it->second + b*itx->second;
 		}
-		CSR_loc->rows.push_back(count);
-	}
-}
-
-template<>
-void parMatrixSparse<double, __int64_t>::Loc_ConvertToCSR(){
-	__int64_t 	count, i, j;
-	double	v;
-
-	typename std::map<__int64_t,double >::iterator it;
-
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<double,__int64_t>(nnz_loc, nrows);
-
-		count = 0;
-
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
+		else{
+			it = row.insert(it, std::make_pair(itx->first, b*itx->second));
+			added++;
 		}
-		CSR_loc->rows.push_back(count);
+		++it;
 	}
-}
-
-
-
-
-
-template<>
-void parMatrixSparse<float, int>::Loc_ConvertToCSR(){
-	int 	count, i, j;
-	float	v;
-
-	typename std::map<int,float>::iterator it;
 
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<float,int>(nnz_loc, nrows);
-
-		count = 0;
-
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
-		}
-		CSR_loc->rows.push_back(count);
+	for(; it != row.end(); ++it){
+		it->second = a*it->second;
 	}
-}
-
-template<>
-void parMatrixSparse<float, __int64_t>::Loc_ConvertToCSR(){
-	__int64_t 	count, i, j;
-	float	v;
-
-	typename std::map<__int64_t,float >::iterator it;
-
-	if(dynmat_loc != NULL){
-		//allocate csr matrix
-
-		CSR_loc = new MatrixCSR<float,__int64_t>(nnz_loc, nrows);
-
-		count = 0;
 
-		for(i = 0; i < nrows; i++){
-			CSR_loc->rows.push_back(count);
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				if(it->second != 0){
-					j = it->first;
-					v = it->second;
-					CSR_loc->vals.push_back(v);
-					CSR_loc->cols.push_back(j);
-					count++;
-				}
-			}
-		}
-		CSR_loc->rows.push_back(count);
-	}
+	return added;
 }
 
-///////////////////////////////
-
-
-
-template<typename T,typename S>
-void parMatrixSparse<T,S>::MatScale(T scale){
-	typename std::map<S,T>::iterator it;
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_MatAXPY(parMatrixSparse<T,S,R> *X, T scale){
 
 	S i;
 
-	if(dynmat_lloc != NULL){
-		for(i = 0; i < nrows; i++){
-			for(it = dynmat_lloc[i].begin(); it != dynmat_lloc[i].end(); it++){
-				it->second = it->second*scale;
-			}
-		}
+	if(X->dynmat_loc == NULL){
+		return;
 	}
 
-	if(dynmat_gloc != NULL){
-		for(i = 0; i < nrows; i++){
-			for(it = dynmat_gloc[i].begin(); it != dynmat_gloc[i].end(); it++){
-				it->second = it->second*scale;
-			}
-		}
+	if(dynmat_loc == NULL){
+		dynmat_loc = NewRows();
 	}
-}
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_MatAXPY(parMatrixSparse<T,S> *X, T scale){
+	S added = 0;
 
-	typename std::map<S,T>::iterator it, itv, itvv;
-
-	S i, k;
-
-	if(dynmat_loc != NULL && X->dynmat_loc != NULL){
-		for(i = 0; i < nrows; i++){
-			std::map<S,T> merge;
-			merge.insert(dynmat_loc[i].begin(),dynmat_loc[i].end());
-			merge.insert(X->dynmat_loc[i].begin(),X->dynmat_loc[i].end());
-			for(it = merge.begin(); it != merge.end(); ++it){
-				k = it->first;
-				dynmat_loc[i][k] = dynmat_loc[i][k]+X->dynmat_loc[i][k]*scale;
-			}
-			merge.clear();
-		}
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:added) schedule(static)
+#endif
+	for(i = 0; i < nrows; i++){
+		added += Loc_MergeRow(dynmat_loc[i], X->dynmat_loc[i], T(1), scale);
 	}
 
-	if(dynmat_loc == NULL && X->dynmat_loc != NULL){
-		for(i = 0; i < nrows; i++){
-			std::map<S,T> merge;
-			merge.insert(X->dynmat_loc[i].begin(),X->dynmat_loc[i].end());
-			for(it = merge.begin(); it != merge.end(); ++it){
-				k = it->first;
-				dynmat_loc[i][k] = X->dynmat_loc[i][k]*scale;
-			}
-			merge.clear();
-		}
-	}
+	nnz_loc += added;
 }
 
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_MatScale(T scale){
-	typename std::map<S,T>::iterator it;
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_MatScale(T scale){
+	typename R::iterator it;
 
 	S i;
 
 	if(dynmat_loc != NULL){
+#ifdef _OPENMP
+#pragma omp parallel for private(it) schedule(static)
+#endif
 		for(i = 0; i < nrows; i++){
 			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
 				it->second = it->second*scale;
@@ -1339,53 +1132,38 @@ void parMatrixSparse<T,S>::Loc_MatScale(T scale){
 	}
 }
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_MatAYPX(parMatrixSparse<T,S> *X, T scale){
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_MatAYPX(parMatrixSparse<T,S,R> *X, T scale){
 
-	typename std::map<S,T>::iterator it, itv, itvv;
+	S i;
 
-	S i, k;
-	if(dynmat_loc != NULL){
-		for(i = 0; i < nrows; i++){
-			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); it++){
-				k = it->first;
-				dynmat_loc[i][k] = dynmat_loc[i][k]*scale;
-			}
-		}
+	if(X->dynmat_loc == NULL){
+		Loc_MatScale(scale);
+		return;
 	}
 
-	if(dynmat_loc != NULL && X->dynmat_loc != NULL){
-		for(i = 0; i < nrows; i++){
-			std::map<S,T> merge;
-			merge.insert(dynmat_loc[i].begin(),dynmat_loc[i].end());
-			merge.insert(X->dynmat_loc[i].begin(),X->dynmat_loc[i].end());
-			for(it = merge.begin(); it != merge.end(); ++it){
-				k = it->first;
-				dynmat_loc[i][k] = dynmat_loc[i][k]+X->dynmat_loc[i][k];
-			}
-			merge.clear();
-		}
+	if(dynmat_loc == NULL){
+		dynmat_loc = NewRows();
 	}
 
-	if(dynmat_loc == NULL && X->dynmat_loc != NULL){
-		for(i = 0; i < nrows; i++){
-			std::map<S,T> merge;
-			merge.insert(X->dynmat_loc[i].begin(),X->dynmat_loc[i].end());
-			for(it = merge.begin(); it != merge.end(); ++it){
-				k = it->first;
-				dynmat_loc[i][k] = X->dynmat_loc[i][k];
-			}
-			merge.clear();
-		}
+	S added = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:added) schedule(static)
+#endif
+	for(i = 0; i < nrows; i++){
+		added += Loc_MergeRow(dynmat_loc[i], X->dynmat_loc[i], scale, T(1));
 	}
+
+	nnz_loc += added;
 }
 
 
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::ZeroEntries()
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::ZeroEntries()
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	S i;
 
@@ -1407,10 +1185,10 @@ void parMatrixSparse<T,S>::ZeroEntries()
 }
 
 
-template<typename T,typename S>
-void parMatrixSparse<T,S>::Loc_ZeroEntries()
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::Loc_ZeroEntries()
 {
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	S i;
 
@@ -1423,26 +1201,59 @@ void parMatrixSparse<T,S>::Loc_ZeroEntries()
 	}
 }
 
+template<typename T, typename S, typename R>
+S parMatrixSparse<T,S,R>::Loc_Prune(double tol)
+{
+	typename R::iterator it;
+
+	S i, removed = 0;
+
+	if(dynmat_loc != NULL){
+#ifdef _OPENMP
+#pragma omp parallel for private(it) reduction(+:removed) schedule(static)
+#endif
+		for(i = 0; i < nrows; i++){
+			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end();){
+				if(std::abs(it->second) <= tol){
+					it = dynmat_loc[i].erase(it);
+					removed++;
+				}
+				else{
+					++it;
+				}
+			}
+		}
+	}
+
+	nnz_loc -= removed;
+
+	return removed;
+}
+
 
 //matrix multiple a special nilpotent matrix
-template<typename T,typename S>
-void parMatrixSparse<T,S>::MA(Nilpotency<S> nilp, parMatrixSparse<T,S> *prod)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::MA(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *prod)
 {
 	S i, j, k;
 
-	typename std::map<S,T>::iterator it;
+	typename R::iterator it;
 
 	//use the given nilpotency matrix, MA operation will make elements of matrix right move diaPosition-1 offset.
 	//And the positions of 0: pos = nbOne*integer - 1
 
-	for(i = 0; i < nrows; i++){
-		if(dynmat_loc == NULL) {
-			return;
-		}
-		if(dynmat_loc != NULL && prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<S,T> [nrows];
-		}
+	if(dynmat_loc == NULL) {
+		return;
+	}
+	if(prod->dynmat_loc == NULL){
+		prod->dynmat_loc = prod->NewRows();
+	}
 
+	//each row of prod only takes entries of the same row of this
+#ifdef _OPENMP
+#pragma omp parallel for private(it, j, k) schedule(static)
+#endif
+	for(i = 0; i < nrows; i++){
 		for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
 			j = it->first + nilp.diagPosition - 1;
 			k = (j+1)%(nilp.nbOne + 1);
@@ -1455,12 +1266,15 @@ void parMatrixSparse<T,S>::MA(Nilpotency<S> nilp, parMatrixSparse<T,S> *prod)
 
 /////////////////
 
-template<>
-void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatrixSparse<std::complex<double>,int> *prod)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::AM(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *prod)
 {
-	int i, j, k, p, q, loc;
+	S i, j, k, p, q, loc;
+
 
-	typename std::map<int,std::complex<double> >::iterator it;
+	typename R::iterator it;
+
+	MPI_Datatype MPI_INDEX = MPI_Index<S>();
 
 	MPI_Request	rtypereq, stypereq;
 
@@ -1469,9 +1283,10 @@ void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatr
 	int up, down;
 	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
 
-	int *sIndx, *rIndx;
-	int gSize = 0, gRsize = 0;
-	int cnt = 0, cnt2 = 0;
+
+	S *sIndx, *rIndx;
+	S gSize = 0, gRsize = 0;
+	S cnt = 0;
 	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
 	MPI_Status indRStats, valRStats;
 
@@ -1481,27 +1296,27 @@ void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatr
 	up = ProcID - 1;
 	down = ProcID + 1;
 
-	int size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
+	S size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
 
 	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
+		for(S a = 0; a < nilp.diagPosition - 1; a++){
 			size[a] = dynmat_loc[a].size();
 		}
 	}
 
 	if(ProcID != nProcs - 1){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
+		for(S a = 0; a < nilp.diagPosition - 1; a++){
 			rsize[a] = 0;
 		}
 	}
 
 
 	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_INT, up, tagtype, comm, &stypereq);
+		MPI_Isend(size, nilp.diagPosition - 1, MPI_INDEX, up, tagtype, comm, &stypereq);
 	}
 
 	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_INT, down, tagtype, comm, &rtypereq);
+		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_INDEX, down, tagtype, comm, &rtypereq);
 		MPI_Wait(&rtypereq,&typestat);
 	}
 
@@ -1510,10 +1325,15 @@ void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatr
 		return;
 	}
 
+	if(prod->dynmat_loc == NULL){
+		prod->dynmat_loc = prod->NewRows();
+	}
+
+	//local part: the row p goes to the row i = p - shift, one row of prod per p
+#ifdef _OPENMP
+#pragma omp parallel for private(it, i, j, k, q) schedule(static)
+#endif
 	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<int,std::complex<double> > [nrows];
-		}
 
 		i = p - nilp.diagPosition + 1;
 		q = y_index_map->Loc2Glob(i);
@@ -1531,68 +1351,63 @@ void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatr
 
 	}
 
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<std::complex<double>>();
+	MPI_Datatype MPI_SCALAR = MPI_Scalar<T>();
 
 	MPI_Barrier(comm);
 
 	// sending and receving
 
 	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
+		for(S a = 0; a < nilp.diagPosition - 1; a++){
 			size[a] = dynmat_loc[a].size();
 		}
 	}
 
 	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
+		for(S b = 0; b < nilp.diagPosition - 1; b++){
 			gSize += size[b];
 		}
 	}
 
 	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
+		for(S b = 0; b < nilp.diagPosition - 1; b++){
 			gRsize += rsize[b];
 		}
 	}
 
 
-	double *sBuf, *rBuf;
+	T *sBuf, *rBuf;
 
 	if(ProcID != 0){
-		sBuf  = new double [2*gSize];
-		sIndx  = new int [gSize];
+		sBuf  = new T [gSize];
+		sIndx  = new S [gSize];
 	}
 
 	if(ProcID != nProcs - 1){
-		rBuf = new double [2*gRsize];
-		rIndx = new int [gRsize];
+		rBuf = new T [gRsize];
+		rIndx = new S [gRsize];
 	}
 
-
 	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
+		for(S b = 0; b < nilp.diagPosition - 1; b++){
 			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = (it->second).real();
-				sBuf[cnt+1] = (it->second).imag();
-				sIndx[cnt2] = it->first;
-				cnt = cnt + 2;
-				cnt2++;
+				sBuf[cnt] = it->second;
+				sIndx[cnt] = it->first;
+				cnt++;
 			}
 		}
 
-		MPI_Isend(sIndx, gSize, MPI_INT, up, tagi, comm, &indSReqs);
+		MPI_Isend(sIndx, gSize, MPI_INDEX, up, tagi, comm, &indSReqs);
 		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
+
 	}
 
 	if(ProcID != nProcs - 1){
-		for(int tt = 0; tt < 2*gRsize; tt++){
-			rBuf[tt] = 0.0;
-		}
-
-		for(int tt = 0; tt < gRsize; tt++){
+		for(S tt = 0; tt < gRsize; tt++){
+			rBuf[tt] = T(0);
 			rIndx[tt] = 0;
 		}
-		MPI_Irecv(rIndx, gRsize, MPI_INT, down, tagi, comm, &indRReqs);
+		MPI_Irecv(rIndx, gRsize, MPI_INDEX, down, tagi, comm, &indRReqs);
 		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
 		
 		MPI_Wait(&indRReqs,&indRStats);
@@ -1601,1195 +1416,351 @@ void parMatrixSparse<std::complex<double>,int>::AM(Nilpotency<int> nilp, parMatr
 	}
 
 	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
+		for(S b = 0; b < nilp.diagPosition - 1; b++){
 			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
 			if((loc + 1)%(nilp.nbOne + 1) != 0){
 				if(b == 0){
-					for(int tt = 0; tt < rsize[b]; tt++){
+					for(S tt = 0; tt < rsize[b]; tt++){
 						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
 					}
 				} else{
-					for(int tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).real(rBuf[2*tt]);
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).imag(rBuf[2*tt + 1]);
+					for(S tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
+						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
 					}
 				}
 			}
 		}
 	}
-
 }
 
 
 
 
-template<>
-void parMatrixSparse<std::complex<double>,__int64_t>::AM(Nilpotency<__int64_t> nilp, parMatrixSparse<std::complex<double>,__int64_t> *prod)
-{
-	__int64_t i, j, k, p, q, loc;
-
-	typename std::map<__int64_t,std::complex<double> >::iterator it;
+////////
 
-	MPI_Request	rtypereq, stypereq;
+//fused kernel of the generation loop: this <- AM - MA, then acc <- acc + scale * this.
+//The new row i only needs the old rows i and i + diagPosition - 1, so sweeping the rows
+//in increasing order can overwrite the rows in place, and no MA/AM temporary is needed.
+//The first diagPosition - 1 rows of the next proc are fetched beforehand.
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::FusedAMMA(Nilpotency<S> nilp, parMatrixSparse<T,S,R> *acc, T scale)
+{
+	typename R::iterator it, ita;
 
-	MPI_Status	typestat;
+	S i, j, p, q, shift, nhalo, rhalo;
 
 	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
 
+	shift = nilp.diagPosition - 1;
 
-	__int64_t *sIndx, *rIndx;
-	__int64_t gSize = 0, gRsize = 0;
-	__int64_t cnt = 0, cnt2 = 0;
+	up = (ProcID == 0) ? MPI_PROC_NULL : ProcID - 1;
+	down = (ProcID == nProcs - 1) ? MPI_PROC_NULL : ProcID + 1;
 
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
+	MPI_Datatype MPI_INDEX = MPI_Index<S>();
+	MPI_Datatype MPI_SCALAR = MPI_Scalar<T>();
 
-	up = ProcID - 1;
-	down = ProcID + 1;
+	// exchange the first shift rows with the previous proc: sizes first, then cols and vals
 
-	__int64_t size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
+	nhalo = (shift < nrows) ? shift : nrows;
 
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
+	std::vector<S> ssize(shift, 0), rsize(shift, 0);
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
+	if(dynmat_loc != NULL){
+		for(p = 0; p < nhalo; p++){
+			ssize[p] = dynmat_loc[p].size();
 		}
 	}
 
+	MPI_Sendrecv(ssize.data(), shift, MPI_INDEX, up, 0, rsize.data(), shift, MPI_INDEX, down, 0, comm, MPI_STATUS_IGNORE);
 
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_LONG_LONG, up, tagtype, comm, &stypereq);
-	}
+	S gSize = 0, gRsize = 0;
 
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_LONG_LONG, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
+	for(p = 0; p < shift; p++){
+		gSize += ssize[p];
+		gRsize += rsize[p];
 	}
 
+	std::vector<S> sIndx(gSize), rIndx(gRsize);
+	std::vector<T> sBuf(gSize), rBuf(gRsize);
 
-	if(dynmat_loc == NULL){
-		return;
-	}
+	S cnt = 0;
 
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<__int64_t,std::complex<double> > [nrows];
+	if(dynmat_loc != NULL){
+		for(p = 0; p < nhalo; p++){
+			for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
+				sIndx[cnt] = it->first;
+				sBuf[cnt] = it->second;
+				cnt++;
+			}
 		}
+	}
 
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
+	MPI_Sendrecv(sIndx.data(), gSize, MPI_INDEX, up, 1, rIndx.data(), gRsize, MPI_INDEX, down, 1, comm, MPI_STATUS_IGNORE);
+	MPI_Sendrecv(sBuf.data(), gSize, MPI_SCALAR, up, 2, rBuf.data(), gRsize, MPI_SCALAR, down, 2, comm, MPI_STATUS_IGNORE);
 
-		k = (q + 1)%(nilp.nbOne + 1);
+	MPI_Type_free(&MPI_SCALAR);
 
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
+	if(dynmat_loc == NULL){
+		return;
+	}
 
-			j = it->first;
+	if(acc->dynmat_loc == NULL){
+		acc->dynmat_loc = acc->NewRows();
+	}
 
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
+	//offsets of the received rows
+	std::vector<S> roff(shift + 1, 0);
 
+	for(p = 0; p < shift; p++){
+		roff[p + 1] = roff[p] + rsize[p];
 	}
 
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<std::complex<double>>();
-
-	MPI_Barrier(comm);
+	/*The rows are split into one contiguous block per thread. The new row i needs the old row
+	  i + shift, which the thread of the next block may already have replaced: the first shift
+	  rows of each block are saved before the sweep*/
+	std::vector<S> bstart;
+	std::vector<std::vector<std::pair<S,T> > > saved;
 
-	// sending and receving
+	S added = 0, accAdded = 0;
 
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
+#ifdef _OPENMP
+#pragma omp parallel private(it, ita, i, j, p, q, rhalo) reduction(+:added, accAdded)
+#endif
+	{
+		int t = 0, nth = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		nth = omp_get_num_threads();
+#pragma omp single
+#endif
+		{
+			bstart.resize(nth + 1);
+			for(int b = 0; b <= nth; b++){
+				bstart[b] = (nrows/nth)*b + ((b < nrows%nth) ? b : nrows%nth);
+			}
+			saved.resize(nth*shift);
 		}
-	}
 
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
+		S b0 = bstart[t], b1 = bstart[t + 1], o, tb;
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
+		for(o = 0; o < shift && b0 + o < b1; o++){
+			saved[t*shift + o].assign(dynmat_loc[b0 + o].begin(), dynmat_loc[b0 + o].end());
 		}
-	}
-
 
-	double *sBuf, *rBuf;
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
 
-	if(ProcID != 0){
-		sBuf  = new double [2*gSize];
-		sIndx  = new __int64_t [gSize];
-	}
+		std::vector<std::pair<S,T> > am, ma;
 
-	if(ProcID != nProcs - 1){
-		rBuf = new double [2*gRsize];
-		rIndx = new __int64_t [gRsize];
-	}
+		//new row, reset for each row: with sortedRow its capacity is reused from row to row
+		R row;
 
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = (it->second).real();
-				sBuf[cnt+1] = (it->second).imag();
-				sIndx[cnt2] = it->first;
-				cnt = cnt + 2;
-				cnt2++;
-			}
-		}
+		rowBinder<R>::Bind(row, pool);
 
-		MPI_Isend(sIndx, gSize, MPI_LONG_LONG, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-	}
+		T v;
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t tt = 0; tt < 2*gRsize; tt++){
-			rBuf[tt] = 0.0;
-		}
+		for(i = b0; i < b1; i++){
 
-		for(__int64_t tt = 0; tt < gRsize; tt++){
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_LONG_LONG, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
+			am.clear();
+			ma.clear();
 
-	}
+			//AM: row i takes the old row i + shift, except at the zeros of the nilpotent matrix
+			q = y_index_map->Loc2Glob(i);
+			p = i + shift;
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(__int64_t tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
+			if((q + 1)%(nilp.nbOne + 1) != 0){
+				if(p < b1){
+					for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
+						am.push_back(*it);
 					}
-				} else{
-					for(__int64_t tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).real(rBuf[2*tt]);
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).imag(rBuf[2*tt + 1]);
+				}
+				else if(p < nrows){
+					tb = std::upper_bound(bstart.begin(), bstart.end(), p) - bstart.begin() - 1;
+					am = saved[tb*shift + p - bstart[tb]];
+				}
+				else{
+					rhalo = p - nrows;
+					for(S tt = roff[rhalo]; tt < roff[rhalo + 1]; tt++){
+						am.push_back(std::make_pair(rIndx[tt], rBuf[tt]));
 					}
 				}
 			}
-		}
-	}
-}
 
+			//MA: the entries of the old row i move right by shift
+			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
+				j = it->first + shift;
+				if(j < ncols && (j + 1)%(nilp.nbOne + 1) != 0){
+					ma.push_back(std::make_pair(j, it->second));
+				}
+			}
 
+			//merge AM - MA into the new row i, both parts are sorted by column. The explicit zeros,
+			//from the cancellations of AM and MA or from the initial matrix, are dropped here, so
+			//that the rows only hold the real nnz from one iteration to the next
+			row.clear();
 
-//////////
+			typename std::vector<std::pair<S,T> >::iterator a = am.begin(), b = ma.begin();
 
-
-template<>
-void parMatrixSparse<std::complex<float>,int>::AM(Nilpotency<int> nilp, parMatrixSparse<std::complex<float>,int> *prod)
-{
-	int i, j, k, p, q, loc;
-
-
-	typename std::map<int,std::complex<float> >::iterator it;
-
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	int *sIndx, *rIndx;
-	int gSize = 0, gRsize = 0;
-	int cnt = 0, cnt2 = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
-
-	int size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
-
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_INT, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_INT, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
-		return;
-	}
-
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<int,std::complex<float> > [nrows];
-		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
-
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<std::complex<float>>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
-
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
-		}
-	}
-
-
-	float *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new float [2*gSize];
-		sIndx  = new int [gSize];
-	}
-
-	if(ProcID != nProcs - 1){
-		rBuf = new float [2*gRsize];
-		rIndx = new int [gRsize];
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = (it->second).real();
-				sBuf[cnt+1] = (it->second).imag();
-				sIndx[cnt2] = it->first;
-				cnt = cnt + 2;
-				cnt2++;
+			while(a != am.end() || b != ma.end()){
+				if(b == ma.end() || (a != am.end() && a->first < b->first)){
+					j = a->first;
+					v = a->second;
+					++a;
+				}
+				else if(a == am.end() || b->first < a->first){
+					j = b->first;
+					v = -b->second;
+					++b;
+				}
+				else{
+					j = a->first;
+					v = a->second - b->second;
+					++a;
+					++b;
+				}
+				if(v != T(0)){
+					row.insert(row.end(), std::make_pair(j, v));
+				}
 			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_INT, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int tt = 0; tt < 2*gRsize; tt++){
-			rBuf[tt] = 0.0;
-		}
 
-		for(int tt = 0; tt < gRsize; tt++){
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_INT, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
+			added += S(row.size()) - S(dynmat_loc[i].size());
+			dynmat_loc[i].swap(row);
 
-	}
+			//acc <- acc + scale * new row i
+			ita = acc->dynmat_loc[i].begin();
 
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(int tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(int tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).real(rBuf[2*tt]);
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).imag(rBuf[2*tt + 1]);
-					}
+			for(it = dynmat_loc[i].begin(); it != dynmat_loc[i].end(); ++it){
+				while(ita != acc->dynmat_loc[i].end() && ita->first < it->first){
+					++ita;
+				}
+				if(ita != acc->dynmat_loc[i].end() && ita->first == it->first){
+					ita->second = ita->second + it->second*scale;
+				}
+				else{
+					ita = acc->dynmat_loc[i].insert(ita, std::make_pair(it->first, it->second*scale));
+					accAdded++;
 				}
 			}
 		}
 	}
+
+	nnz_loc += added;
+	acc->nnz_loc += accAdded;
 }
 
+template<typename T>
+void mmReadValue(std::istream &in, T &value){
+	double v = 0;
+	in >> v;
+	value = T(v);
+}
 
-////////////
+template<typename T>
+void mmReadValue(std::istream &in, std::complex<T> &value){
+	double re = 0, im = 0;
+	in >> re >> im;
+	value = std::complex<T>(re, im);
+}
 
-template<>
-void parMatrixSparse<std::complex<float>,__int64_t>::AM(Nilpotency<__int64_t> nilp, parMatrixSparse<std::complex<float>,__int64_t> *prod)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::ReadExtMat(std::string file)
 {
-	__int64_t i, j, k, p, q, loc;
-
+	std::ifstream in(file.c_str());
+	std::string line;
 
-	typename std::map<__int64_t,std::complex<float> >::iterator it;
+	bool symmetric = false, skew = false, header = true;
+	long row, col, m, n, nz;
+	T value;
 
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	__int64_t *sIndx, *rIndx;
-	__int64_t gSize = 0, gRsize = 0;
-	__int64_t cnt = 0, cnt2 = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
-
-	__int64_t size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
-
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_LONG_LONG, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_LONG_LONG, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
+	if(!in.is_open()){
+		if(ProcID == 0) printf("ERROR ]> Cannot open the matrix file %s\n", file.c_str());
 		return;
 	}
 
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<__int64_t,std::complex<float> > [nrows];
+	while(std::getline(in, line)){
+		if(line.empty()){
+			continue;
 		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
+		if(line[0] == '%'){
+			if(line.find("symmetric") != std::string::npos){
+				symmetric = true;
+				skew = (line.find("skew") != std::string::npos);
 			}
+			continue;
 		}
 
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<std::complex<float>>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
+		std::stringstream linestream(line);
 
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
+		//size line "M N NNZ"
+		if(header){
+			linestream >> m >> n >> nz;
+			if(m > ncols || n > ncols){
+				if(ProcID == 0) printf("ERROR ]> The matrix of %s is %ld x %ld, larger than the vectors of size %ld\n", file.c_str(), m, n, (long)ncols);
+				return;
+			}
+			header = false;
+			continue;
 		}
-	}
 
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
+		linestream >> row >> col;
+		mmReadValue(linestream, value);
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
+		Loc_SetValue(S(row - 1), S(col - 1), value);
+		if(symmetric && row != col){
+			Loc_SetValue(S(col - 1), S(row - 1), skew ? T(0) - value : value);
 		}
 	}
+}
 
-
-	float *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new float [2*gSize];
-		sIndx  = new __int64_t [gSize];
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::FindColsToRecv()
+{
+	//the matrix set by the global SetValue is in the lloc and gloc rows
+	if(CSR_loc == NULL && dynmat_loc == NULL && (dynmat_lloc != NULL || dynmat_gloc != NULL)){
+		glocPlusLloc();
 	}
 
-	if(ProcID != nProcs - 1){
-		rBuf = new float [2*gRsize];
-		rIndx = new __int64_t [gRsize];
+	if(CSR_loc == NULL && dynmat_loc != NULL){
+		Loc_ConvertToCSR();
 	}
 
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = (it->second).real();
-				sBuf[cnt+1] = (it->second).imag();
-				sIndx[cnt2] = it->first;
-				cnt = cnt + 2;
-				cnt2++;
-			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_LONG_LONG, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
+	//no local entries
+	if(CSR_loc == NULL){
+		CSR_loc.reset(new MatrixCSR<T,S>(0, nrows));
+		CSR_loc->ncols = ncols;
+		CSR_loc->rows.assign(nrows + 1, 0);
 	}
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t tt = 0; tt < 2*gRsize; tt++){
-			rBuf[tt] = 0.0;
-		}
-
-		for(__int64_t tt = 0; tt < gRsize; tt++){
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_LONG_LONG, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
+	spmv_plan.reset(new spmvPlan<T,S>(CSR_loc.get(), x_index_map.get()));
+}
 
+template<typename T, typename S, typename R>
+spmvPlan<T,S> *parMatrixSparse<T,S,R>::GetSpMVPlan()
+{
+	if(spmv_plan == NULL){
+		FindColsToRecv();
 	}
 
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(__int64_t tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(__int64_t tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).real(rBuf[2*tt]);
-						(prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]]).imag(rBuf[2*tt + 1]);
-					}
-				}
-			}
-		}
-	}
+	return spmv_plan.get();
 }
 
-
-
-////////////////////////
-
-
-template<>
-void parMatrixSparse<double,int>::AM(Nilpotency<int> nilp, parMatrixSparse<double,int> *prod)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::SetupDataTypes()
 {
-	int i, j, k, p, q, loc;
-
-
-	typename std::map<int,double >::iterator it;
-
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	int *sIndx, *rIndx;
-	int gSize = 0, gRsize = 0;
-	int cnt = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
+	GetSpMVPlan()->SetupDataTypes();
+}
 
-	int size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::CSR_MatVecProd(parVector<T,S> *x, parVector<T,S> *y)
+{
+	GetSpMVPlan()->Apply(x, y);
+}
 
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_INT, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_INT, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
-		return;
-	}
-
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<int,double > [nrows];
-		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
-
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<double>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
-
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
-		}
-	}
-
-
-	double *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new double [gSize];
-		sIndx  = new int [gSize];
-	}
-
-	if(ProcID != nProcs - 1){
-		rBuf = new double [gRsize];
-		rIndx = new int [gRsize];
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = it->second;
-				sIndx[cnt] = it->first;
-				cnt++;
-			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_INT, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int tt = 0; tt < gRsize; tt++){
-			rBuf[tt] = 0.0;
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_INT, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(int tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(int tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				}
-			}
-		}
-	}
-}
-
-
-
-
-////////
-
-
-
-template<>
-void parMatrixSparse<double,__int64_t>::AM(Nilpotency<__int64_t> nilp, parMatrixSparse<double,__int64_t> *prod)
-{
-	__int64_t i, j, k, p, q, loc;
-
-
-	typename std::map<__int64_t,double >::iterator it;
-
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	__int64_t *sIndx, *rIndx;
-	__int64_t gSize = 0, gRsize = 0;
-	__int64_t cnt = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
-
-	__int64_t size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
-
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_LONG_LONG, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_LONG_LONG, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
-		return;
-	}
-
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<__int64_t,double > [nrows];
-		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
-
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<double>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
-
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
-		}
-	}
-
-
-	double *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new double [gSize];
-		sIndx  = new __int64_t [gSize];
-	}
-
-	if(ProcID != nProcs - 1){
-		rBuf = new double [gRsize];
-		rIndx = new __int64_t [gRsize];
-	}
-
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = it->second;
-				sIndx[cnt] = it->first;
-				cnt++;
-			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_LONG_LONG, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t tt = 0; tt < gRsize; tt++){
-			rBuf[tt] = 0.0;
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_LONG_LONG, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(__int64_t tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(__int64_t tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				}
-			}
-		}
-	}
-}
-
-
-
-
-
-
-//////////////////////////
-
-
-template<>
-void parMatrixSparse<float,int>::AM(Nilpotency<int> nilp, parMatrixSparse<float,int> *prod)
+template<typename T, typename S, typename R>
+void parMatrixSparse<T,S,R>::CSR_MatMultiVecProd(parMultiVector<T,S> *X, parMultiVector<T,S> *Y)
 {
-	int i, j, k, p, q, loc;
-
-
-	typename std::map<int,float >::iterator it;
-
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	int *sIndx, *rIndx;
-	int gSize = 0, gRsize = 0;
-	int cnt = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
-
-	int size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
-
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_INT, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_INT, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
-		return;
-	}
-
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<int,float > [nrows];
-		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
-
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<float>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
-
-	if(ProcID != 0){
-		for(int a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
-		}
-	}
-
-
-	float *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new float [gSize];
-		sIndx  = new int [gSize];
-	}
-
-	if(ProcID != nProcs - 1){
-		rBuf = new float [gRsize];
-		rIndx = new int [gRsize];
-	}
-
-	if(ProcID != 0){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = it->second;
-				sIndx[cnt] = it->first;
-				cnt++;
-			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_INT, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int tt = 0; tt < gRsize; tt++){
-			rBuf[tt] = 0.0;
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_INT, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(int b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(int tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(int tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				}
-			}
-		}
-	}
-}
-
-
-
-
-////////
-
-
-template<>
-void parMatrixSparse<float,__int64_t>::AM(Nilpotency<__int64_t> nilp, parMatrixSparse<float,__int64_t> *prod)
-{
-	__int64_t i, j, k, p, q, loc;
-
-
-	typename std::map<__int64_t,float >::iterator it;
-
-	MPI_Request	rtypereq, stypereq;
-
-	MPI_Status	typestat;
-
-	int up, down;
-	int	tagtype = nilp.diagPosition - 1 + nilp.diagPosition ;
-
-
-	__int64_t *sIndx, *rIndx;
-	__int64_t gSize = 0, gRsize = 0;
-	__int64_t cnt = 0;
-	MPI_Request	indSReqs, indRReqs, valSReqs, valRReqs;
-	MPI_Status indRStats, valRStats;
-
-	int tagv = 0;
-	int tagi = 1;
-
-	up = ProcID - 1;
-	down = ProcID + 1;
-
-	__int64_t size[nilp.diagPosition - 1], rsize[nilp.diagPosition - 1];
-
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			rsize[a] = 0;
-		}
-	}
-
-
-	if(ProcID != 0){
-		MPI_Isend(size, nilp.diagPosition - 1, MPI_LONG_LONG, up, tagtype, comm, &stypereq);
-	}
-
-	if(ProcID != nProcs - 1){
-		MPI_Irecv(rsize,nilp.diagPosition - 1, MPI_LONG_LONG, down, tagtype, comm, &rtypereq);
-		MPI_Wait(&rtypereq,&typestat);
-	}
-
-
-	if(dynmat_loc == NULL){
-		return;
-	}
-
-	for(p = nilp.diagPosition - 1; p < nrows; p++){
-		if(prod->dynmat_loc == NULL){
-			prod->dynmat_loc = new std::map<__int64_t,float > [nrows];
-		}
-
-		i = p - nilp.diagPosition + 1;
-		q = y_index_map->Loc2Glob(i);
-
-		k = (q + 1)%(nilp.nbOne + 1);
-
-		for(it = dynmat_loc[p].begin(); it != dynmat_loc[p].end(); ++it){
-
-			j = it->first;
-
-			if(i >= 0 && i < nrows && k != 0){
-				prod->dynmat_loc[i][j] = it->second;
-			}
-		}
-
-	}
-
-	MPI_Datatype MPI_SCALAR = MPI_Scalar<float>();
-
-	MPI_Barrier(comm);
-
-	// sending and receving
-
-	if(ProcID != 0){
-		for(__int64_t a = 0; a < nilp.diagPosition - 1; a++){
-			size[a] = dynmat_loc[a].size();
-		}
-	}
-
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gSize += size[b];
-		}
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			gRsize += rsize[b];
-		}
-	}
-
-
-	float *sBuf, *rBuf;
-
-	if(ProcID != 0){
-		sBuf  = new float [gSize];
-		sIndx  = new __int64_t [gSize];
-	}
-
-	if(ProcID != nProcs - 1){
-		rBuf = new float [gRsize];
-		rIndx = new __int64_t [gRsize];
-	}
-
-	if(ProcID != 0){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			for(it = dynmat_loc[b].begin(); it != dynmat_loc[b].end(); ++it){
-				sBuf[cnt] = it->second;
-				sIndx[cnt] = it->first;
-				cnt++;
-			}
-		}
-
-		MPI_Isend(sIndx, gSize, MPI_LONG_LONG, up, tagi, comm, &indSReqs);
-		MPI_Isend(sBuf, gSize, MPI_SCALAR, up, tagv, comm, &valSReqs);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t tt = 0; tt < gRsize; tt++){
-			rBuf[tt] = 0.0;
-			rIndx[tt] = 0;
-		}
-		MPI_Irecv(rIndx, gRsize, MPI_LONG_LONG, down, tagi, comm, &indRReqs);
-		MPI_Irecv(rBuf, gRsize, MPI_SCALAR, down, tagv, comm, &valRReqs);
-		
-		MPI_Wait(&indRReqs,&indRStats);
-		MPI_Wait(&valRReqs,&valRStats);
-
-	}
-
-	if(ProcID != nProcs - 1){
-		for(__int64_t b = 0; b < nilp.diagPosition - 1; b++){
-			loc = y_index_map->Loc2Glob(nrows - nilp.diagPosition + 1 + b);
-			if((loc + 1)%(nilp.nbOne + 1) != 0){
-				if(b == 0){
-					for(__int64_t tt = 0; tt < rsize[b]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				} else{
-					for(__int64_t tt = rsize[b - 1]; tt < rsize[b] + rsize[b - 1]; tt++){
-						prod->dynmat_loc[nrows - nilp.diagPosition + 1 + b][rIndx[tt]] = rBuf[tt];
-					}
-				}
-			}
-		}
-	}
+	GetSpMVPlan()->Apply(X, Y);
 }
 
 #endif
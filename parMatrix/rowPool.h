@@ -0,0 +1,277 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __ROW_POOL_H__
+#define __ROW_POOL_H__
+
+#include <map>
+#include <vector>
+#include <functional>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*Slab arena with one free list per size (multiple of 16 bytes), used by one thread at a time.
+  The blocks larger than maxBlock go to the heap*/
+class rowArena
+{
+	private:
+		static const size_t	align = 16;
+		static const size_t	maxBlock = 512;
+		static const size_t	slabSize = 1 << 20;
+
+		std::vector<char *>	slabs;
+
+		//next free byte of the last slab and its end
+		char	*head, *tail;
+
+		//free lists, one per size class
+		void	*freeList[maxBlock/align + 1];
+
+		size_t	bytes;
+
+	public:
+		rowArena(){
+			head = NULL;
+			tail = NULL;
+			bytes = 0;
+			for(size_t c = 0; c <= maxBlock/align; c++){
+				freeList[c] = NULL;
+			}
+		};
+
+		~rowArena(){
+			for(size_t s = 0; s < slabs.size(); s++){
+				::operator delete(slabs[s]);
+			}
+		};
+
+		void *Allocate(size_t n){
+
+			if(n > maxBlock){
+				return ::operator new(n);
+			}
+
+			size_t c = (n + align - 1)/align;
+
+			if(freeList[c] != NULL){
+				void *p = freeList[c];
+				freeList[c] = *(void **)p;
+				return p;
+			}
+
+			n = c*align;
+
+			if(head == NULL || size_t(tail - head) < n){
+				head = (char *)::operator new(slabSize);
+				tail = head + slabSize;
+				slabs.push_back(head);
+				bytes = bytes + slabSize;
+			}
+
+			void *p = head;
+			head = head + n;
+
+			return p;
+		};
+
+		void Deallocate(void *p, size_t n){
+
+			if(n > maxBlock){
+				::operator delete(p);
+				return;
+			}
+
+			size_t c = (n + align - 1)/align;
+
+			*(void **)p = freeList[c];
+			freeList[c] = p;
+		};
+
+		size_t GetBytes(){return bytes;};
+};
+
+
+/*Memory pool of the rows of one matrix, so that a node of a std::map row costs neither a malloc
+  nor its header. All the slabs are given back at once when the pool is deleted, with the matrix.
+
+  With OpenMP, each thread of the row-parallel kernels has its own arena (omp_get_max_threads()
+  of them at the creation of the pool), so the inserts of different rows do not contend. A block
+  freed by a thread goes to the free list of this thread, whichever arena it came from: all the
+  blocks live until the pool is deleted. The threads beyond this number share one more arena
+  under a critical section*/
+class rowPool
+{
+	private:
+		std::vector<rowArena *>	arenas;
+
+		rowArena	overflow;
+
+		int	Thread(){
+#ifdef _OPENMP
+			return omp_get_thread_num();
+#else
+			return 0;
+#endif
+		};
+
+	public:
+		rowPool(){
+#ifdef _OPENMP
+			arenas.resize(omp_get_max_threads());
+#else
+			arenas.resize(1);
+#endif
+			for(size_t a = 0; a < arenas.size(); a++){
+				arenas[a] = new rowArena();
+			}
+		};
+
+		~rowPool(){
+			for(size_t a = 0; a < arenas.size(); a++){
+				delete arenas[a];
+			}
+		};
+
+		void *Allocate(size_t n){
+			size_t t = Thread();
+			void *p;
+
+			if(t < arenas.size()){
+				return arenas[t]->Allocate(n);
+			}
+#ifdef _OPENMP
+#pragma omp critical(rowPoolOverflow)
+#endif
+			p = overflow.Allocate(n);
+
+			return p;
+		};
+
+		void Deallocate(void *p, size_t n){
+			size_t t = Thread();
+
+			if(t < arenas.size()){
+				arenas[t]->Deallocate(p, n);
+				return;
+			}
+#ifdef _OPENMP
+#pragma omp critical(rowPoolOverflow)
+#endif
+			overflow.Deallocate(p, n);
+		};
+
+		//bytes taken from the heap by the slabs
+		size_t GetBytes(){
+			size_t bytes = overflow.GetBytes();
+			for(size_t a = 0; a < arenas.size(); a++){
+				bytes = bytes + arenas[a]->GetBytes();
+			}
+			return bytes;
+		};
+};
+
+
+/*Allocator on a rowPool, on the heap without pool. It follows the containers on copy, move and
+  swap, so a row bound to the pool of its matrix stays on it*/
+template<class U>
+class poolAllocator
+{
+	public:
+		typedef U			value_type;
+		typedef std::true_type	propagate_on_container_copy_assignment;
+		typedef std::true_type	propagate_on_container_move_assignment;
+		typedef std::true_type	propagate_on_container_swap;
+
+		rowPool	*pool;
+
+		poolAllocator(){pool = NULL;};
+		poolAllocator(rowPool *pool_in){pool = pool_in;};
+
+		template<class V>
+		poolAllocator(const poolAllocator<V> &other){pool = other.pool;};
+
+		U *allocate(size_t n){
+			if(pool == NULL){
+				return (U *)::operator new(n*sizeof(U));
+			}
+			return (U *)pool->Allocate(n*sizeof(U));
+		};
+
+		void deallocate(U *p, size_t n){
+			if(pool == NULL){
+				::operator delete(p);
+			}else{
+				pool->Deallocate(p, n*sizeof(U));
+			}
+		};
+};
+
+template<class U, class V>
+bool operator==(const poolAllocator<U> &a, const poolAllocator<V> &b){return a.pool == b.pool;}
+
+template<class U, class V>
+bool operator!=(const poolAllocator<U> &a, const poolAllocator<V> &b){return a.pool != b.pool;}
+
+
+//std::map row whose nodes come from the pool of its matrix, to be given as the row storage R of parMatrixSparse
+template<typename S, typename T>
+using pooledMap = std::map<S, T, std::less<S>, poolAllocator<std::pair<const S,T> > >;
+
+
+/*Binds a row of a matrix to the pool of the matrix: nothing for the rows with the default
+  allocator, pooled is true for the pooled rows. dropped is true when the rows can be released
+  without destroying their trees, the nodes being given back with the slabs of the pool*/
+template<class R>
+struct rowBinder
+{
+	static const bool pooled = false;
+	static const bool dropped = false;
+
+	static void Bind(R &, rowPool *){};
+};
+
+template<typename S, typename T, class C>
+struct rowBinder<std::map<S, T, C, poolAllocator<std::pair<const S,T> > > >
+{
+	typedef std::map<S, T, C, poolAllocator<std::pair<const S,T> > > R;
+
+	static const bool pooled = true;
+
+	//no destructor to run in the nodes
+	static const bool dropped = std::is_trivially_destructible<S>::value && std::is_trivially_destructible<T>::value;
+
+	static void Bind(R &row, rowPool *pool){
+		R empty((C()), poolAllocator<std::pair<const S,T> >(pool));
+		row.swap(empty);
+	};
+};
+
+#endif
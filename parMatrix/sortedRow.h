@@ -0,0 +1,142 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SORTED_ROW_H__
+#define __SORTED_ROW_H__
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+/*Row of a sparse matrix stored as one contiguous array of (col, val) pairs sorted by col.
+
+  It has the part of the interface of std::map<S,T> used by parMatrixSparse (iterators on pairs
+  with ->first and ->second, find, operator[], insert with hint, erase, swap, ...), so that it can
+  be given as the row storage R of parMatrixSparse<T,S,R>. A nonzero costs sizeof(pair<S,T>)
+  instead of a tree node of about 48 bytes more, a row is one allocation, and a sweep over a row
+  is a sweep over an array.
+
+  The rows of the generation are banded and built by increasing cols, so the inserts are appends.
+  An insert in the middle of a row costs O(row size), and, unlike std::map, it invalidates the
+  iterators of the row: the insert functions return the iterator on the inserted entry. For many
+  inserts in random order, std::map remains the better choice*/
+template<typename S, typename T>
+class sortedRow
+{
+	public:
+		typedef S							key_type;
+		typedef T							mapped_type;
+		typedef std::pair<S,T>				value_type;
+		typedef typename std::vector<value_type>::iterator			iterator;
+		typedef typename std::vector<value_type>::const_iterator	const_iterator;
+		typedef typename std::vector<value_type>::size_type			size_type;
+
+	private:
+		std::vector<value_type>	entries;
+
+		struct colLess
+		{
+			bool operator()(const value_type &a, const S &col) const {return a.first < col;};
+		};
+
+	public:
+		iterator		begin(){return entries.begin();};
+		iterator		end(){return entries.end();};
+		const_iterator	begin() const {return entries.begin();};
+		const_iterator	end() const {return entries.end();};
+
+		size_type	size() const {return entries.size();};
+		bool		empty() const {return entries.empty();};
+		void		clear(){entries.clear();};
+		void		reserve(size_type n){entries.reserve(n);};
+		void		swap(sortedRow<S,T> &other){entries.swap(other.entries);};
+
+		//first entry whose col is not less than col
+		iterator lower_bound(const S &col){
+			return std::lower_bound(entries.begin(), entries.end(), col, colLess());
+		};
+
+		iterator find(const S &col){
+			iterator it = lower_bound(col);
+			return (it != entries.end() && it->first == col) ? it : entries.end();
+		};
+
+		size_type count(const S &col){
+			return (find(col) != entries.end()) ? 1 : 0;
+		};
+
+		//value at col, inserted as zero if absent; O(1) when col is after the last entry
+		T &operator[](const S &col){
+			if(entries.empty() || entries.back().first < col){
+				entries.push_back(value_type(col, T(0)));
+				return entries.back().second;
+			}
+			iterator it = lower_bound(col);
+			if(it == entries.end() || it->first != col){
+				it = entries.insert(it, value_type(col, T(0)));
+			}
+			return it->second;
+		};
+
+		//insert if the col is absent, the hint is the position to try first as in std::map
+		iterator insert(iterator hint, const value_type &value){
+			if((hint == entries.end() || value.first < hint->first) && (hint == entries.begin() || (hint - 1)->first < value.first)){
+				return entries.insert(hint, value);
+			}
+			iterator it = lower_bound(value.first);
+			if(it != entries.end() && it->first == value.first){
+				return it;
+			}
+			return entries.insert(it, value);
+		};
+
+		std::pair<iterator,bool> insert(const value_type &value){
+			size_type n = entries.size();
+			iterator it = insert(entries.end(), value);
+			return std::make_pair(it, entries.size() != n);
+		};
+
+		template<class InputIt>
+		void insert(InputIt first, InputIt last){
+			for(; first != last; ++first){
+				insert(value_type(first->first, first->second));
+			}
+		};
+
+		iterator erase(iterator pos){
+			return entries.erase(pos);
+		};
+
+		size_type erase(const S &col){
+			iterator it = find(col);
+			if(it == entries.end()){
+				return 0;
+			}
+			entries.erase(it);
+			return 1;
+		};
+};
+
+#endif
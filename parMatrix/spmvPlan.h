@@ -0,0 +1,705 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SPMV_PLAN_H__
+#define __SPMV_PLAN_H__
+
+#include <mpi.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "../utils/MPI_DataType.h"
+#include "../utils/simdKernels.h"
+#include "../parVector/parVector.h"
+#include "../parVector/parMultiVector.h"
+#include "MatrixCSR.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*Plan of the distributed product y = A x of the local CSR rows of a matrix, whose cols are global.
+
+  The setup, done once, finds the cols owned by the other procs (the ghosts), tells their owners
+  which entries of x to send, and numbers the cols of the CSR in Rbuffer: the local entries of x,
+  then the ghosts. It splits the rows into the interior ones, whose cols are all local, and the
+  boundary ones, which need a ghost.
+
+  A product is Begin (the receives and sends of the ghosts are posted), Interior (the interior
+  rows, while the ghosts are on their way), End (wait for the ghosts, then the boundary rows).
+  The generated matrices are banded, so all but about the bandwidth rows at both ends of the
+  local range are interior, and the exchange is hidden behind almost all the product.
+
+  The exchange is set up once with the plan (SetupDataTypes) and reused at each product, with one
+  of the modes:
+
+	SPMV_PERSISTENT	(default) persistent requests MPI_Send_init/MPI_Recv_init on the fixed buffers
+					of the plan, started at each product: the entries of x sent are packed first
+	SPMV_NEIGHBOR	MPI_Ineighbor_alltoallv on a distributed graph communicator of the procs
+					which exchange ghosts, so that the MPI library sees the neighbor pattern
+	SPMV_DATATYPES	MPI_Isend/MPI_Irecv at each product, the entries of x sent straight from x
+					with MPI indexed datatypes
+
+  The block product Y = A X of a parMultiVector X of k vectors goes the same way, with a kernel
+  which reads each row of the CSR once and accumulates its k sums, so that the matrix, which is
+  most of the memory traffic of a product, is read once for the k vectors. The k entries of a
+  ghost are sent together, in the same message per proc as one entry for a single vector. The
+  exchange is set up for the number of vectors of the product, and set up again when it changes.
+
+  The plan keeps a pointer to the CSR and should be built again if it changes*/
+
+//exchange of the ghosts of an spmvPlan
+enum spmvCommMode {SPMV_PERSISTENT, SPMV_NEIGHBOR, SPMV_DATATYPES};
+
+template<typename T, typename S>
+class spmvPlan
+{
+	private:
+		MPI_Comm	comm;
+		int			ProcID, nProcs;
+
+		MatrixCSR<T,S>	*csr;
+
+		S	lower_x, upper_x, nloc, nrows;
+
+		//number of entries of x received from and sent to each proc, and their offsets
+		std::vector<S>	VNumRecv, VNumSend;
+		std::vector<S>	RecvOffset, SendOffset;
+
+		//global cols received (the ghosts, sorted by owner and col), local indices of x sent
+		std::vector<S>	ColsToRecv, IdxToSend;
+
+		//cols of the CSR numbered in Rbuffer
+		std::vector<S>	SpMVCols;
+
+		//rows without and with ghost cols, as ranges [first, second) of consecutive rows
+		std::vector<std::pair<S,S> >	interior, boundary;
+
+		//entries of x used by the local rows: the local ones, then the width entries of each ghost
+		std::vector<T>	Rbuffer;
+
+		//entries of the local x sent to the other procs, packed in the order of IdxToSend
+		std::vector<T>	Sbuffer;
+
+		//exchange of the ghosts, set up by SetupExchange for width vectors
+		int		mode;
+		int		width;
+		bool	comm_ready;
+
+		//block product in progress, between Begin and End
+		parMultiVector<T,S>	*Xcur;
+
+		//SPMV_DATATYPES: entries of the local x sent to each proc
+		std::vector<MPI_Datatype>	DTypeSend;
+		MPI_Datatype				DTypeScalar;
+
+		//requests of the exchange in progress, persistent ones for SPMV_PERSISTENT
+		std::vector<MPI_Request>	reqs;
+
+		//SPMV_NEIGHBOR: graph of the procs which exchange ghosts, and the counts and offsets on it
+		MPI_Comm			graph_comm;
+		std::vector<int>	nbr_rcount, nbr_rdispl, nbr_scount, nbr_sdispl;
+
+		//y[i] for the rows i of the ranges
+		void	RowsProd(std::vector<std::pair<S,S> > &ranges, T *y);
+
+		//the k entries of the rows i of the ranges of Y, X being Xcur
+		void	RowsProd(std::vector<std::pair<S,S> > &ranges, parMultiVector<T,S> *Y);
+
+		//same for k = K known at compile time, with the sums in registers, k = width otherwise (K = 0)
+		template<int K>
+		void	RowsProdK(std::vector<std::pair<S,S> > &ranges, parMultiVector<T,S> *Y);
+
+		//number of rows of the ranges
+		S	NumRows(std::vector<std::pair<S,S> > &ranges);
+
+		//free the requests, datatypes and communicator of the exchange
+		void	FreeComm();
+
+		void	Pack(T *xa);
+		void	Pack(parMultiVector<T,S> *X);
+
+		//set up the exchange of k entries per ghost
+		void	SetupExchange(int k);
+
+		//post the exchange of the ghosts, the packed Sbuffer being sent, or xa with SPMV_DATATYPES
+		void	Post(T *xa);
+
+	public:
+		//collective on the comm of xmap: analysis of the cols of csr, x being distributed by xmap
+		spmvPlan(MatrixCSR<T,S> *csr_in, parVectorMap<S> *xmap);
+
+		~spmvPlan();
+
+		spmvPlan(const spmvPlan<T,S> &) = delete;
+		spmvPlan<T,S> &operator=(const spmvPlan<T,S> &) = delete;
+
+		//set up the exchange of the ghosts of one vector for the mode, done by Begin if needed
+		void	SetupDataTypes(){SetupExchange(1);};
+
+		//mode of the exchange, SPMV_PERSISTENT by default, set up again at the next Begin
+		void	SetCommMode(spmvCommMode m);
+		int		GetCommMode(){return mode;};
+
+		//post the exchange of the ghosts of x; x should not be modified before End
+		void	Begin(parVector<T,S> *x);
+
+		//interior rows of y
+		void	Interior(parVector<T,S> *y);
+
+		//wait for the ghosts, then boundary rows of y
+		void	End(parVector<T,S> *y);
+
+		//y = A x
+		void	Apply(parVector<T,S> *x, parVector<T,S> *y){
+			Begin(x);
+			Interior(y);
+			End(y);
+		};
+
+		//block product Y = A X, in the same steps; X and Y have the same number of vectors
+		void	Begin(parMultiVector<T,S> *X);
+		void	Interior(parMultiVector<T,S> *Y);
+		void	End(parMultiVector<T,S> *Y);
+
+		void	Apply(parMultiVector<T,S> *X, parMultiVector<T,S> *Y){
+			Begin(X);
+			Interior(Y);
+			End(Y);
+		};
+
+		S	GetNumGhosts(){return ColsToRecv.size();};
+		S	GetNumInterior(){return NumRows(interior);};
+		S	GetNumBoundary(){return NumRows(boundary);};
+};
+
+
+template<typename T, typename S>
+spmvPlan<T,S>::spmvPlan(MatrixCSR<T,S> *csr_in, parVectorMap<S> *xmap)
+{
+	S	i, k, c, nnz, nghost;
+	int	p;
+	bool	ghost;
+
+	MPI_Datatype MPI_INDEX = MPI_Index<S>();
+
+	csr = csr_in;
+
+	comm = xmap->GetCurrentComm();
+	MPI_Comm_rank(comm, &ProcID);
+	MPI_Comm_size(comm, &nProcs);
+
+	lower_x = xmap->GetLowerBound();
+	upper_x = xmap->GetUpperBound();
+	nloc = upper_x - lower_x;
+	nrows = csr->nrows;
+	nnz = csr->nnz;
+
+	mode = SPMV_PERSISTENT;
+	width = 1;
+	comm_ready = false;
+	Xcur = NULL;
+	DTypeScalar = MPI_DATATYPE_NULL;
+	graph_comm = MPI_COMM_NULL;
+
+	for(k = 0; k < nnz; k++){
+		c = csr->cols[k];
+		if(c < lower_x || c >= upper_x){
+			ColsToRecv.push_back(c);
+		}
+	}
+
+	//sorted by col, thus by owner since the procs hold contiguous ranges of x
+	std::sort(ColsToRecv.begin(), ColsToRecv.end());
+	ColsToRecv.erase(std::unique(ColsToRecv.begin(), ColsToRecv.end()), ColsToRecv.end());
+
+	nghost = ColsToRecv.size();
+
+	VNumRecv.assign(nProcs, 0);
+	VNumSend.assign(nProcs, 0);
+
+	for(i = 0; i < nghost; i++){
+		VNumRecv[xmap->GetOwner(ColsToRecv[i])]++;
+	}
+
+	MPI_Alltoall(VNumRecv.data(), 1, MPI_INDEX, VNumSend.data(), 1, MPI_INDEX, comm);
+
+	RecvOffset.assign(nProcs + 1, 0);
+	SendOffset.assign(nProcs + 1, 0);
+
+	std::vector<int> rcount(nProcs), rdispl(nProcs), scount(nProcs), sdispl(nProcs);
+
+	for(p = 0; p < nProcs; p++){
+		RecvOffset[p + 1] = RecvOffset[p] + VNumRecv[p];
+		SendOffset[p + 1] = SendOffset[p] + VNumSend[p];
+		rcount[p] = VNumRecv[p];
+		rdispl[p] = RecvOffset[p];
+		scount[p] = VNumSend[p];
+		sdispl[p] = SendOffset[p];
+	}
+
+	//each proc tells the owners which of their entries it needs
+	IdxToSend.assign(SendOffset[nProcs], 0);
+
+	MPI_Alltoallv(ColsToRecv.data(), rcount.data(), rdispl.data(), MPI_INDEX, IdxToSend.data(), scount.data(), sdispl.data(), MPI_INDEX, comm);
+
+	for(i = 0; i < SendOffset[nProcs]; i++){
+		IdxToSend[i] = IdxToSend[i] - lower_x;
+	}
+
+	//cols numbered in Rbuffer: [0, nloc) for the local entries, nloc + g for the ghost g
+	SpMVCols.resize(nnz);
+
+	for(i = 0; i < nrows; i++){
+		ghost = false;
+		for(k = csr->rows[i]; k < csr->rows[i + 1]; k++){
+			c = csr->cols[k];
+			if(c >= lower_x && c < upper_x){
+				SpMVCols[k] = c - lower_x;
+			}
+			else{
+				SpMVCols[k] = nloc + (std::lower_bound(ColsToRecv.begin(), ColsToRecv.end(), c) - ColsToRecv.begin());
+				ghost = true;
+			}
+		}
+		std::vector<std::pair<S,S> > &ranges = ghost ? boundary : interior;
+		if(!ranges.empty() && ranges.back().second == i){
+			ranges.back().second = i + 1;
+		}
+		else{
+			ranges.push_back(std::make_pair(i, i + 1));
+		}
+	}
+
+	Rbuffer.assign(nloc + nghost, T(0));
+	Sbuffer.assign(SendOffset[nProcs], T(0));
+}
+
+template<typename T, typename S>
+spmvPlan<T,S>::~spmvPlan()
+{
+	FreeComm();
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::FreeComm()
+{
+	int finalized;
+
+	MPI_Finalized(&finalized);
+
+	if(!finalized){
+		if(mode == SPMV_PERSISTENT){
+			for(size_t q = 0; q < reqs.size(); q++){
+				MPI_Request_free(&reqs[q]);
+			}
+		}
+		for(size_t p = 0; p < DTypeSend.size(); p++){
+			if(DTypeSend[p] != MPI_DATATYPE_NULL){
+				MPI_Type_free(&DTypeSend[p]);
+			}
+		}
+		if(DTypeScalar != MPI_DATATYPE_NULL){
+			MPI_Type_free(&DTypeScalar);
+		}
+		if(graph_comm != MPI_COMM_NULL){
+			MPI_Comm_free(&graph_comm);
+		}
+	}
+
+	reqs.clear();
+	DTypeSend.clear();
+	DTypeScalar = MPI_DATATYPE_NULL;
+	graph_comm = MPI_COMM_NULL;
+
+	comm_ready = false;
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::SetCommMode(spmvCommMode m)
+{
+	if(m != mode){
+		FreeComm();
+		mode = m;
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::SetupExchange(int k)
+{
+	int p;
+
+	FreeComm();
+
+	width = k;
+
+	//the requests below are bound to the buffers, which are not reallocated until the next setup
+	Rbuffer.assign(nloc + ColsToRecv.size()*width, T(0));
+	Sbuffer.assign(IdxToSend.size()*width, T(0));
+
+	DTypeScalar = MPI_Scalar<T>();
+
+	//the entries of one vector are sent straight from x, the ones of a block are packed
+	if(mode == SPMV_DATATYPES && width == 1){
+		DTypeSend.assign(nProcs, MPI_DATATYPE_NULL);
+
+		std::vector<int> displ;
+
+		for(p = 0; p < nProcs; p++){
+			if(VNumSend[p] > 0){
+				displ.assign(IdxToSend.begin() + SendOffset[p], IdxToSend.begin() + SendOffset[p + 1]);
+				MPI_Type_create_indexed_block(VNumSend[p], 1, displ.data(), DTypeScalar, &DTypeSend[p]);
+				MPI_Type_commit(&DTypeSend[p]);
+			}
+		}
+	}
+	else if(mode == SPMV_PERSISTENT){
+		for(p = 0; p < nProcs; p++){
+			if(VNumRecv[p] > 0){
+				reqs.push_back(MPI_Request());
+				MPI_Recv_init(Rbuffer.data() + nloc + RecvOffset[p]*width, VNumRecv[p]*width, DTypeScalar, p, 0, comm, &reqs.back());
+			}
+		}
+		for(p = 0; p < nProcs; p++){
+			if(VNumSend[p] > 0){
+				reqs.push_back(MPI_Request());
+				MPI_Send_init(Sbuffer.data() + SendOffset[p]*width, VNumSend[p]*width, DTypeScalar, p, 0, comm, &reqs.back());
+			}
+		}
+	}
+	else if(mode == SPMV_NEIGHBOR){
+		std::vector<int> sources, destinations;
+
+		nbr_rcount.clear();
+		nbr_rdispl.clear();
+		nbr_scount.clear();
+		nbr_sdispl.clear();
+
+		for(p = 0; p < nProcs; p++){
+			if(VNumRecv[p] > 0){
+				sources.push_back(p);
+				nbr_rcount.push_back(VNumRecv[p]*width);
+				nbr_rdispl.push_back(RecvOffset[p]*width);
+			}
+			if(VNumSend[p] > 0){
+				destinations.push_back(p);
+				nbr_scount.push_back(VNumSend[p]*width);
+				nbr_sdispl.push_back(SendOffset[p]*width);
+			}
+		}
+
+		//the ranks are kept, the counts are given in the order of the neighbors
+		MPI_Dist_graph_create_adjacent(comm, sources.size(), sources.data(), MPI_UNWEIGHTED, destinations.size(), destinations.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &graph_comm);
+	}
+
+	comm_ready = true;
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Pack(T *xa)
+{
+	S n = IdxToSend.size();
+
+	for(S j = 0; j < n; j++){
+		Sbuffer[j] = xa[IdxToSend[j]];
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Pack(parMultiVector<T,S> *X)
+{
+	S n = IdxToSend.size();
+
+	for(S j = 0; j < n; j++){
+		for(int v = 0; v < width; v++){
+			Sbuffer[j*width + v] = X->GetValueLocal(IdxToSend[j], v);
+		}
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Post(T *xa)
+{
+	int p;
+
+	T *xw = Rbuffer.data();
+
+	if(mode == SPMV_DATATYPES){
+		reqs.clear();
+
+		for(p = 0; p < nProcs; p++){
+			if(VNumRecv[p] > 0){
+				reqs.push_back(MPI_Request());
+				MPI_Irecv(xw + nloc + RecvOffset[p]*width, VNumRecv[p]*width, DTypeScalar, p, 0, comm, &reqs.back());
+			}
+		}
+
+		for(p = 0; p < nProcs; p++){
+			if(VNumSend[p] > 0){
+				reqs.push_back(MPI_Request());
+				if(width == 1){
+					MPI_Isend(xa, 1, DTypeSend[p], p, 0, comm, &reqs.back());
+				}else{
+					MPI_Isend(Sbuffer.data() + SendOffset[p]*width, VNumSend[p]*width, DTypeScalar, p, 0, comm, &reqs.back());
+				}
+			}
+		}
+	}
+	else if(mode == SPMV_PERSISTENT){
+		if(!reqs.empty()){
+			MPI_Startall(reqs.size(), reqs.data());
+		}
+	}
+	else{
+		reqs.assign(1, MPI_REQUEST_NULL);
+		MPI_Ineighbor_alltoallv(Sbuffer.data(), nbr_scount.data(), nbr_sdispl.data(), DTypeScalar, xw + nloc, nbr_rcount.data(), nbr_rdispl.data(), DTypeScalar, graph_comm, &reqs[0]);
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Begin(parVector<T,S> *x)
+{
+	if(!comm_ready || width != 1){
+		SetupExchange(1);
+	}
+
+	if(x->GetLocalSize() != nloc){
+		printf("ERROR ]> spmvPlan: the local size of x is %ld, it should be %ld\n", (long)x->GetLocalSize(), (long)nloc);
+		return;
+	}
+
+	T *xa = x->GetArray();
+
+	if(mode != SPMV_DATATYPES){
+		Pack(xa);
+	}
+
+	Post(xa);
+
+	std::copy(xa, xa + nloc, Rbuffer.data());
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Begin(parMultiVector<T,S> *X)
+{
+	Xcur = NULL;
+
+	if(X->GetLocalSize() != nloc){
+		printf("ERROR ]> spmvPlan: the local size of X is %ld, it should be %ld\n", (long)X->GetLocalSize(), (long)nloc);
+		return;
+	}
+
+	if(!comm_ready || width != X->GetNumVectors()){
+		SetupExchange(X->GetNumVectors());
+	}
+
+	//the local entries are read in X by the product, only the ghosts go to Rbuffer
+	Pack(X);
+	Post(X->GetArray());
+
+	Xcur = X;
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::RowsProd(std::vector<std::pair<S,S> > &ranges, T *y)
+{
+	const S	*rows = csr->rows.data();
+	const S	*cols = SpMVCols.data();
+	const T	*vals = csr->vals.data();
+	const T	*xw = Rbuffer.data();
+
+	//rows by the SIMD kernel of the cpu, see simdKernels.h
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		S nt = 1, t = 0;
+#ifdef _OPENMP
+		nt = omp_get_num_threads();
+		t = omp_get_thread_num();
+#endif
+		for(size_t r = 0; r < ranges.size(); r++){
+			//one contiguous part of the range per thread, as schedule(static)
+			S n = ranges[r].second - ranges[r].first;
+			S chunk = (n + nt - 1)/nt;
+			S lo = ranges[r].first + std::min(n, t*chunk);
+			S hi = ranges[r].first + std::min(n, t*chunk + chunk);
+
+			csrRowsProd(rows, cols, vals, xw, y, lo, hi);
+		}
+	}
+}
+
+template<typename T, typename S>
+S spmvPlan<T,S>::NumRows(std::vector<std::pair<S,S> > &ranges)
+{
+	S n = 0;
+
+	for(size_t r = 0; r < ranges.size(); r++){
+		n = n + ranges[r].second - ranges[r].first;
+	}
+	return n;
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Interior(parVector<T,S> *y)
+{
+	if(y->GetLocalSize() != nrows){
+		printf("ERROR ]> spmvPlan: the local size of y is %ld, it should be %ld\n", (long)y->GetLocalSize(), (long)nrows);
+		return;
+	}
+
+	RowsProd(interior, y->GetArray());
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::End(parVector<T,S> *y)
+{
+	MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+
+	//the persistent requests are inactive again, to be started by the next Begin
+	if(mode != SPMV_PERSISTENT){
+		reqs.clear();
+	}
+
+	if(y->GetLocalSize() != nrows){
+		return;
+	}
+
+	RowsProd(boundary, y->GetArray());
+}
+
+template<typename T, typename S>
+template<int K>
+void spmvPlan<T,S>::RowsProdK(std::vector<std::pair<S,S> > &ranges, parMultiVector<T,S> *Y)
+{
+	const S	*rows = csr->rows.data();
+	const S	*cols = SpMVCols.data();
+	const T	*vals = csr->vals.data();
+	const T	*ghosts = Rbuffer.data() + nloc;
+	const T	*xa = Xcur->GetArray();
+	T		*ya = Y->GetArray();
+
+	const int	k = (K > 0) ? K : width;
+
+	//(i, j) of X at xa[i*xrs + j*xcs], of Y at ya[i*yrs + j*ycs]
+	const S	xrs = (Xcur->GetLayout() == MV_INTERLEAVED) ? k : 1;
+	const S	xcs = (Xcur->GetLayout() == MV_INTERLEAVED) ? 1 : nloc;
+	const S	yrs = (Y->GetLayout() == MV_INTERLEAVED) ? k : 1;
+	const S	ycs = (Y->GetLayout() == MV_INTERLEAVED) ? 1 : nrows;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		//the k sums of a row, on the stack for K > 0
+		T				acc_k[(K > 0) ? K : 1];
+		std::vector<T>	acc_v((K > 0) ? 0 : k);
+		T				*acc = (K > 0) ? acc_k : acc_v.data();
+
+		S		i, kk, c;
+		int		j;
+		T		v;
+		const T	*xr;
+
+		for(size_t r = 0; r < ranges.size(); r++){
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+			for(i = ranges[r].first; i < ranges[r].second; i++){
+				for(j = 0; j < k; j++){
+					acc[j] = T(0);
+				}
+				for(kk = rows[i]; kk < rows[i + 1]; kk++){
+					v = vals[kk];
+					c = cols[kk];
+					if(c < nloc){
+						xr = xa + c*xrs;
+						for(j = 0; j < k; j++){
+							acc[j] += v * xr[j*xcs];
+						}
+					}
+					else{
+						xr = ghosts + (c - nloc)*k;
+						for(j = 0; j < k; j++){
+							acc[j] += v * xr[j];
+						}
+					}
+				}
+				for(j = 0; j < k; j++){
+					ya[i*yrs + j*ycs] = acc[j];
+				}
+			}
+		}
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::RowsProd(std::vector<std::pair<S,S> > &ranges, parMultiVector<T,S> *Y)
+{
+	//the usual widths of the block methods
+	switch(width){
+		case 2:		RowsProdK<2>(ranges, Y);	break;
+		case 4:		RowsProdK<4>(ranges, Y);	break;
+		case 8:		RowsProdK<8>(ranges, Y);	break;
+		case 16:	RowsProdK<16>(ranges, Y);	break;
+		default:	RowsProdK<0>(ranges, Y);	break;
+	}
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::Interior(parMultiVector<T,S> *Y)
+{
+	if(Xcur == NULL){
+		return;
+	}
+
+	if(Y->GetLocalSize() != nrows || Y->GetNumVectors() != width){
+		printf("ERROR ]> spmvPlan: Y has %d vectors of local size %ld, it should have %d of %ld\n", Y->GetNumVectors(), (long)Y->GetLocalSize(), width, (long)nrows);
+		return;
+	}
+
+	RowsProd(interior, Y);
+}
+
+template<typename T, typename S>
+void spmvPlan<T,S>::End(parMultiVector<T,S> *Y)
+{
+	MPI_Waitall(reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+
+	if(mode != SPMV_PERSISTENT){
+		reqs.clear();
+	}
+
+	if(Xcur == NULL || Y->GetLocalSize() != nrows || Y->GetNumVectors() != width){
+		return;
+	}
+
+	RowsProd(boundary, Y);
+
+	Xcur = NULL;
+}
+
+#endif
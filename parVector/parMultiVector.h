@@ -0,0 +1,258 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __PAR_MULTI_VECTOR_H__
+#define __PAR_MULTI_VECTOR_H__
+
+#include <mpi.h>
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+#include "parVectorMap.h"
+#include "parVector.h"
+
+/*Block of k distributed vectors on the same map, for the block methods (block Krylov, many
+  right-hand sides), whose products A X with a sparse matrix read the matrix once for the k
+  vectors, see spmvPlan.
+
+  The local entries are stored in one array, with one of the layouts:
+
+	MV_COLMAJOR		the k local vectors one after the other, (i, j) at j*local_size + i, so that
+					a vector is a contiguous array as in parVector
+	MV_INTERLEAVED	the k entries of a row together, (i, j) at i*k + j, so that a row of A
+					reads k contiguous entries for each of its cols
+
+  The product is faster with MV_INTERLEAVED, MV_COLMAJOR is the one of the vectors taken one by
+  one. SetLayout converts the entries in place*/
+
+//layout of the local entries of a parMultiVector
+enum multiVecLayout {MV_COLMAJOR, MV_INTERLEAVED};
+
+template<typename T, typename S>
+class parMultiVector{
+	private:
+		T	*array;
+		S	local_size;
+		int	nvec;
+		int	layout;
+		std::shared_ptr<parVectorMap<S> > index_map;
+
+	public:
+		parMultiVector();
+		parMultiVector(MPI_Comm ncomm, S lbound, S ubound, int k, multiVecLayout lay = MV_INTERLEAVED);
+		//k vectors on an existing map, which is shared and not duplicated
+		parMultiVector(std::shared_ptr<parVectorMap<S> > map, int k, multiVecLayout lay = MV_INTERLEAVED);
+		~parMultiVector();
+
+		//move only, as parVector
+		parMultiVector(parMultiVector<T,S> &&v);
+		parMultiVector<T,S> &operator=(parMultiVector<T,S> &&v);
+		parMultiVector(const parMultiVector<T,S> &) = delete;
+		parMultiVector<T,S> &operator=(const parMultiVector<T,S> &) = delete;
+
+		parVectorMap<S> *GetVecMap(){return index_map.get();};
+		std::shared_ptr<parVectorMap<S> > ShareVecMap(){return index_map;};
+
+		S GetLowerBound(){return (index_map != NULL) ? index_map->GetLowerBound() : 0;};
+		S GetUpperBound(){return (index_map != NULL) ? index_map->GetUpperBound() : 0;};
+		S GetGlobalSize(){return (index_map != NULL) ? index_map->GetGlobalSize() : 0;};
+		S GetLocalSize(){return local_size;};
+		int GetNumVectors(){return nvec;};
+		int GetLayout(){return layout;};
+		T *GetArray(){return array;};
+
+		//position of the local entry (i, j) in the array
+		S Index(S i, int j){
+			return (layout == MV_INTERLEAVED) ? i*nvec + j : S(j)*local_size + i;
+		};
+
+		T GetValueLocal(S row, int j){return array[Index(row, j)];};
+		void SetValueLocal(S row, int j, T value);
+		void SetValueGlobal(S index, int j, T value);
+
+		void SetTovalue(T value);
+		void SetToZero();
+
+		//copy of the vector j into v, and of v into the vector j; v is on the same map
+		void GetVector(int j, parVector<T,S> *v);
+		void SetVector(int j, parVector<T,S> *v);
+
+		//convert the local entries to the layout lay
+		void SetLayout(multiVecLayout lay);
+};
+
+template<typename T,typename S>
+parMultiVector<T,S>::parMultiVector(){
+	array = NULL;
+	local_size = 0;
+	nvec = 0;
+	layout = MV_INTERLEAVED;
+}
+
+template<typename T,typename S>
+parMultiVector<T,S>::parMultiVector(MPI_Comm ncomm, S lbound, S ubound, int k, multiVecLayout lay)
+{
+	index_map = std::make_shared<parVectorMap<S> >(ncomm, lbound, ubound);
+
+	local_size = index_map->GetLocalSize();
+	nvec = k;
+	layout = lay;
+	array = new T[local_size*nvec];
+}
+
+template<typename T,typename S>
+parMultiVector<T,S>::parMultiVector(std::shared_ptr<parVectorMap<S> > map, int k, multiVecLayout lay)
+{
+	index_map = map;
+
+	local_size = index_map->GetLocalSize();
+	nvec = k;
+	layout = lay;
+	array = new T[local_size*nvec];
+}
+
+template<typename T,typename S>
+parMultiVector<T,S>::parMultiVector(parMultiVector<T,S> &&v)
+{
+	array = v.array;
+	local_size = v.local_size;
+	nvec = v.nvec;
+	layout = v.layout;
+	index_map = std::move(v.index_map);
+
+	v.array = NULL;
+	v.local_size = 0;
+	v.nvec = 0;
+}
+
+template<typename T,typename S>
+parMultiVector<T,S> &parMultiVector<T,S>::operator=(parMultiVector<T,S> &&v)
+{
+	//the former array and map are released by v
+	std::swap(array, v.array);
+	std::swap(local_size, v.local_size);
+	std::swap(nvec, v.nvec);
+	std::swap(layout, v.layout);
+	index_map.swap(v.index_map);
+
+	return *this;
+}
+
+template<typename T,typename S>
+parMultiVector<T,S>::~parMultiVector()
+{
+	if (array != NULL){
+		delete [] array;
+	}
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetValueLocal(S row, int j, T value)
+{
+	if (row >= 0 && row < local_size && j >= 0 && j < nvec){
+		array[Index(row, j)] = value;
+	}
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetValueGlobal(S index, int j, T value)
+{
+	SetValueLocal(index_map->Glob2Loc(index), j, value);
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetTovalue(T value)
+{
+	S n = local_size*nvec;
+
+	for(S i = 0; i < n; i++){
+		array[i] = value;
+	}
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetToZero()
+{
+	T val = 0;
+	SetTovalue(val);
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::GetVector(int j, parVector<T,S> *v)
+{
+	if(v->GetLocalSize() != local_size || j < 0 || j >= nvec){
+		printf("ERROR ]> parMultiVector: cannot get the vector %d into a vector of local size %ld\n", j, (long)v->GetLocalSize());
+		return;
+	}
+
+	T *va = v->GetArray();
+
+	for(S i = 0; i < local_size; i++){
+		va[i] = array[Index(i, j)];
+	}
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetVector(int j, parVector<T,S> *v)
+{
+	if(v->GetLocalSize() != local_size || j < 0 || j >= nvec){
+		printf("ERROR ]> parMultiVector: cannot set the vector %d from a vector of local size %ld\n", j, (long)v->GetLocalSize());
+		return;
+	}
+
+	T *va = v->GetArray();
+
+	for(S i = 0; i < local_size; i++){
+		array[Index(i, j)] = va[i];
+	}
+}
+
+template<typename T, typename S>
+void parMultiVector<T,S>::SetLayout(multiVecLayout lay)
+{
+	if(lay == layout || array == NULL){
+		layout = lay;
+		return;
+	}
+
+	T *converted = new T[local_size*nvec];
+
+	for(S i = 0; i < local_size; i++){
+		for(int j = 0; j < nvec; j++){
+			if(lay == MV_INTERLEAVED){
+				converted[i*nvec + j] = array[S(j)*local_size + i];
+			}else{
+				converted[S(j)*local_size + i] = array[i*nvec + j];
+			}
+		}
+	}
+
+	delete [] array;
+	array = converted;
+	layout = lay;
+}
+
+#endif
@@ -32,9 +32,31 @@ SOFTWARE.
 #include <sstream>
 #include <string>
 #include <complex>
+#include <memory>
+#include <utility>
 
 #include "parVectorMap.h"
 #include "../utils/utils.h"
+#include "../utils/simdKernels.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//the info on the internal spectrum is shown once by the proc 0 of MPI_COMM_WORLD, even if the
+//spectrum is generated many times, e.g. by row blocks or for an ensemble of matrices
+inline bool specGenInfo(){
+	static bool shown = false;
+	int rank;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	if(shown || rank != 0){
+		return false;
+	}
+	shown = true;
+	return true;
+}
 
 template<typename T, typename S>
 class parVector{
@@ -42,14 +64,23 @@ class parVector{
 		T	*array;
 		S	array_size;
 		S	local_size;
-		parVectorMap<S> *index_map;
+		std::shared_ptr<parVectorMap<S> > index_map;
 
 	public:
 		parVector();
 		parVector(MPI_Comm ncomm, S lbound, S ubound);
+		//vector on an existing map, which is shared and not duplicated
+		parVector(std::shared_ptr<parVectorMap<S> > map);
 		~parVector();
 
-		parVectorMap<S> *GetVecMap(){return index_map;};
+		//move only: the array and the map go with the vector
+		parVector(parVector<T,S> &&v);
+		parVector<T,S> &operator=(parVector<T,S> &&v);
+		parVector(const parVector<T,S> &) = delete;
+		parVector<T,S> &operator=(const parVector<T,S> &) = delete;
+
+		parVectorMap<S> *GetVecMap(){return index_map.get();};
+		std::shared_ptr<parVectorMap<S> > ShareVecMap(){return index_map;};
 
 		S GetLowerBound();
 		S GetUpperBound();
@@ -73,6 +104,8 @@ class parVector{
 		void SetToZero();
 
 		void VecAdd(parVector *v);
+		//this = this + a*v, with the SIMD kernel of the cpu, see simdKernels.h
+		void VecAXPY(T a, parVector *v);
 		void VecScale(T scale);
 		T    VecDot(parVector *v);
 		void ReadExtVec(std::string spectrum);
@@ -92,27 +125,56 @@ parVector<T,S>::parVector(){
 	array = NULL;
 	array_size = 0;
 	local_size = 0;
-	index_map = NULL;
 }
 
 template<typename T,typename S>
 parVector<T,S>::parVector(MPI_Comm ncomm, S lbound, S ubound)
 {
-	index_map = new parVectorMap<S>(ncomm, lbound, ubound);
-	index_map->AddUser();
+	index_map = std::make_shared<parVectorMap<S> >(ncomm, lbound, ubound);
 
 	local_size = index_map->GetLocalSize();
 	array_size = index_map->GetLocTotSize();
 	array = new T[array_size];
 }
 
+template<typename T,typename S>
+parVector<T,S>::parVector(std::shared_ptr<parVectorMap<S> > map)
+{
+	index_map = map;
+
+	local_size = index_map->GetLocalSize();
+	array_size = index_map->GetLocTotSize();
+	array = new T[array_size];
+}
+
+template<typename T,typename S>
+parVector<T,S>::parVector(parVector<T,S> &&v)
+{
+	array = v.array;
+	array_size = v.array_size;
+	local_size = v.local_size;
+	index_map = std::move(v.index_map);
+
+	v.array = NULL;
+	v.array_size = 0;
+	v.local_size = 0;
+}
+
+template<typename T,typename S>
+parVector<T,S> &parVector<T,S>::operator=(parVector<T,S> &&v)
+{
+	//the former array and map are released by v
+	std::swap(array, v.array);
+	std::swap(array_size, v.array_size);
+	std::swap(local_size, v.local_size);
+	index_map.swap(v.index_map);
+
+	return *this;
+}
+
 template<typename T,typename S>
 parVector<T,S>::~parVector()
 {
-	if (index_map !=NULL){
-		index_map->DeleteUser();
-		if(index_map->GetUser() == 0){delete index_map;}
-	}
 	if (array != NULL){
 		delete [] array;
 	}
@@ -177,7 +239,7 @@ S parVector<T,S>::Glob2Loc(S global_index)
 template<typename T, typename S>
 void parVector<T,S>::AddValueLocal(S row, T value)
 {
-	if (row < array_size){
+	if (row >= 0 && row < array_size){
 		array[row] = array[row] + value;
 		//array[row] = value;
 	}
@@ -194,7 +256,7 @@ void parVector<T,S>::AddValuesLocal(S nindex, S *rows, T *values)
 template<typename T, typename S>
 void parVector<T,S>::SetValueLocal(S row, T value)
 {
-	if (row < array_size){
+	if (row >= 0 && row < array_size){
 		array[row] = value;
 	}
 }
@@ -241,18 +303,37 @@ void parVector<T,S>::SetToZero()
 
 template<typename T, typename S>
 void parVector<T,S>::VecAdd(parVector<T,S> *v)
+{
+	VecAXPY(T(1), v);
+}
+
+template<typename T, typename S>
+void parVector<T,S>::VecAXPY(T a, parVector<T,S> *v)
 {
 	if(array_size != v->array_size){std::cout << "vector size not coherant" << std::endl;}
 	else{
-		for(S i = 0; i < array_size; i++){
-			array[i] = array[i] + v->array[i];
+#ifdef _OPENMP
+		//one contiguous part of the array per thread, as schedule(static)
+#pragma omp parallel
+		{
+			S nt = omp_get_num_threads(), t = omp_get_thread_num();
+			S chunk = (array_size + nt - 1)/nt;
+			S lo = std::min(array_size, t*chunk), hi = std::min(array_size, lo + chunk);
+
+			simdAxpy(hi - lo, a, v->array + lo, array + lo);
 		}
+#else
+		simdAxpy(array_size, a, v->array, array);
+#endif
 	}
 }
 
 template<typename T, typename S>
 void parVector<T,S>::VecScale(T scale)
 {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
 	for(S i = 0; i < array_size; i++){
 		array[i] = scale*array[i];
 	}
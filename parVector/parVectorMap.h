@@ -57,14 +57,17 @@ class parVectorMap
 		std::map<S,S> loc2glob;
 		std::map<S,S> glob2loc;
 
-		int users;
-
 	public:
 		//constructor
 		parVectorMap(MPI_Comm ncomm, S lbound, S ubound);
 		//destroyer
 		~parVectorMap();
 
+		//a map owns its communicator: it is shared between the vectors and matrices built on it
+		//(std::shared_ptr, see parVector::ShareVecMap), never copied
+		parVectorMap(const parVectorMap<S> &) = delete;
+		parVectorMap<S> &operator=(const parVectorMap<S> &) = delete;
+
 		MPI_Comm GetCurrentComm(){return comm;};
 
 		S Loc2Glob(S local_index);
@@ -80,13 +83,6 @@ class parVectorMap
 		S GetGlobalSize(){return global_size;};
 		S GetLocTotSize(){return loctot_size;};
 
-
-		//Active usrs
-
-		int AddUser(){users++; return users;};
-		int DeleteUser(){users--;return users;};
-		int GetUser(){return users;};
-
 };
 
 
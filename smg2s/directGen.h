@@ -0,0 +1,342 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __DIRECT_GEN_H__
+#define __DIRECT_GEN_H__
+
+#include "../utils/utils.h"
+#include <vector>
+#include <algorithm>
+#include <complex>
+#include <limits>
+
+/*Closed form of the generated matrix.
+
+  Each iteration of the loop in smg2s() applies X <- NL*X - X*NR, where NL moves the row i+s up to
+  the row i unless (i+1)%(nbOne+1) == 0, and NR moves the column c right to c+s unless
+  (c+s+1)%(nbOne+1) == 0, with s = diagPosition - 1. Both shifts commute, so after the loop
+
+		Am = sum_{a+b <= 2*nbOne} 1/(a! b!) NL^a * A0 * (-NR)^b
+
+  and the row i of Am only depends on the rows i, i+s, ..., i+2*nbOne*s of the initial matrix A0.
+  Each row is built on its own: each entry of the row i+a*s of A0 is added at 2*nbOne-a+1 cols of
+  a dense accumulator, so a row costs O(nbOne^2*lbandwidth) updates plus a sweep of MaxRowSize().
+  This is not fewer flops than the loop, which costs O(nbOne*nnz) for the whole matrix, but no
+  intermediate matrix is held nor exchanged, and any range of rows can be built alone.
+
+  The terms are not summed in the order of the loop, so the entries which cancel there leave a roundoff
+  residue here. An entry is dropped when it is below Tol() times the sum of the magnitudes of its terms*/
+
+//machine epsilon of the real type of T
+template<typename T>
+struct realEpsilon
+{
+	static double Value(){return std::numeric_limits<T>::epsilon();};
+};
+
+template<typename T>
+struct realEpsilon<std::complex<T> >
+{
+	static double Value(){return std::numeric_limits<T>::epsilon();};
+};
+
+//term coef * (part kind of the eigenvalue idx) of the entry at col of a symbolic row
+template<typename T, typename S>
+struct symTerm
+{
+	S		col;
+	S		idx;
+	char	kind;
+	T		coef;
+
+	bool operator<(const symTerm &t) const{
+		if(col != t.col){return col < t.col;}
+		if(idx != t.idx){return idx < t.idx;}
+		return kind < t.kind;
+	};
+};
+
+template<typename T, typename S>
+class directGen
+{
+	private:
+		S	probSize;
+		S	nbOne, shift, nterms;
+		S	lband, uband;
+
+		// 1/k!, k = 0..2*nbOne
+		std::vector<double>	invfac;
+
+		// dense accumulator of one row, covering the cols [i - lband, i + nterms*shift + uband]
+		std::vector<T>		work;
+		std::vector<char>	used;
+
+		// sum of the magnitudes of the terms of each entry of the accumulator
+		std::vector<double>	mag;
+
+		// relative tolerance under which an entry is a residue of cancelled terms
+		double	tol;
+
+		// buffer of one row of A0
+		std::vector<S>		icols;
+		std::vector<T>		ivals;
+		std::vector<S>		iidx;
+		std::vector<char>	ikind;
+
+		// terms depending on the spectrum of one symbolic row
+		std::vector<symTerm<T,S> >	terms;
+
+	public:
+		template<class Init>
+		directGen(Nilpotency<S> nilp, S size, Init &A0){
+			probSize = size;
+			nbOne = nilp.nbOne;
+			shift = nilp.diagPosition - 1;
+			nterms = 2*nbOne;
+			lband = A0.LowerBand();
+			uband = A0.UpperBand();
+
+			invfac = invFactorials(nterms);
+
+			//an entry sums at most nterms + 1 terms of each row of A0
+			tol = double(nterms + 1)*realEpsilon<T>::Value();
+
+			work.assign(MaxRowSize(), T(0));
+			used.assign(MaxRowSize(), 0);
+			mag.assign(MaxRowSize(), 0.0);
+			icols.resize(A0.MaxRowSize());
+			ivals.resize(A0.MaxRowSize());
+			iidx.resize(A0.MaxRowSize());
+			ikind.resize(A0.MaxRowSize());
+		};
+
+		S	MaxRowSize(){return lband + nterms*shift + uband + 1;};
+
+		//rows of A0 below the row i which are needed to build it
+		S	RowHalo(){return nterms*shift;};
+
+		double	Tol(){return tol;};
+
+		//the last merged coef of an entry with n terms is 0 if it is a residue of cancelled terms
+		void	FlushCoef(std::vector<T> &tcoef, S n, double tmag){
+			if(n > 0 && std::abs(tcoef.back()) <= tol*tmag){
+				tcoef.back() = T(0);
+			}
+		};
+
+		//row i of the generated matrix with increasing cols, returns the number of entries
+		template<class Init>
+		S	Row(S i, Init &A0, S *cols, T *vals){
+
+			S r, c, col, n0, cnt;
+			S base = i - lband;
+			double coef;
+
+			r = i;
+
+			for(S a = 0; a <= nterms; a++){
+				//NL^a: the row i takes the row i + a*s, if no zero of NL is met on the way
+				if(a > 0){
+					if((r + 1)%(nbOne + 1) == 0 || r + shift >= probSize){
+						break;
+					}
+					r = r + shift;
+				}
+
+				n0 = A0.Row(r, icols.data(), ivals.data());
+
+				for(S k = 0; k < n0; k++){
+					c = icols[k];
+					col = c;
+					//(-NR)^b: the entry moves right by b*s, if no zero of NR is met on the way
+					for(S b = 0; a + b <= nterms; b++){
+						if(b > 0){
+							if(col + shift >= probSize || (col + shift + 1)%(nbOne + 1) == 0){
+								break;
+							}
+							col = col + shift;
+						}
+						coef = (b % 2 == 0) ? invfac[a]*invfac[b] : -invfac[a]*invfac[b];
+						work[col - base] = work[col - base] + ivals[k]*T(coef);
+						mag[col - base] += std::abs(ivals[k])*std::abs(coef);
+						used[col - base] = 1;
+					}
+				}
+			}
+
+			cnt = 0;
+
+			for(S w = 0; w < MaxRowSize(); w++){
+				if(used[w]){
+					//the residues of the cancelled entries are dropped
+					if(std::abs(work[w]) > tol*mag[w]){
+						cols[cnt] = base + w;
+						vals[cnt] = work[w];
+						cnt++;
+					}
+					work[w] = T(0);
+					mag[w] = 0.0;
+					used[w] = 0;
+				}
+			}
+
+			return cnt;
+		};
+
+		//number of entries of the row i before any drop, which is the one of SymRow()
+		template<class Init>
+		S	RowSize(S i, Init &A0){
+
+			S r, col, n0, cnt;
+			S base = i - lband;
+
+			r = i;
+
+			for(S a = 0; a <= nterms; a++){
+				if(a > 0){
+					if((r + 1)%(nbOne + 1) == 0 || r + shift >= probSize){
+						break;
+					}
+					r = r + shift;
+				}
+
+				n0 = A0.Row(r, icols.data(), ivals.data());
+
+				for(S k = 0; k < n0; k++){
+					col = icols[k];
+					for(S b = 0; a + b <= nterms; b++){
+						if(b > 0){
+							if(col + shift >= probSize || (col + shift + 1)%(nbOne + 1) == 0){
+								break;
+							}
+							col = col + shift;
+						}
+						used[col - base] = 1;
+					}
+				}
+			}
+
+			cnt = 0;
+
+			for(S w = 0; w < MaxRowSize(); w++){
+				if(used[w]){
+					cnt++;
+					used[w] = 0;
+				}
+			}
+
+			return cnt;
+		};
+
+		/*symbolic row i with the cols of Row() before any drop: base gets the part of the values which does not
+		  depend on the spectrum, and the nterm[k] terms of the entry k are appended to (tidx, tkind, tcoef), so
+		  that its value is base[k] + sum_t tcoef[t] * A0.Eval(tidx[t], tkind[t]). The residues of base and of
+		  the merged coefs are flushed to 0, the cols are kept*/
+		template<class Init>
+		S	SymRow(S i, Init &A0, S *cols, T *base, S *nterm, std::vector<S> &tidx, std::vector<char> &tkind, std::vector<T> &tcoef){
+
+			S r, col, n0, cnt, t;
+			S base_col = i - lband;
+			double coef, tmag;
+			symTerm<T,S> term;
+
+			terms.clear();
+
+			r = i;
+
+			for(S a = 0; a <= nterms; a++){
+				if(a > 0){
+					if((r + 1)%(nbOne + 1) == 0 || r + shift >= probSize){
+						break;
+					}
+					r = r + shift;
+				}
+
+				n0 = A0.SymRow(r, icols.data(), ivals.data(), iidx.data(), ikind.data());
+
+				for(S k = 0; k < n0; k++){
+					col = icols[k];
+					for(S b = 0; a + b <= nterms; b++){
+						if(b > 0){
+							if(col + shift >= probSize || (col + shift + 1)%(nbOne + 1) == 0){
+								break;
+							}
+							col = col + shift;
+						}
+						coef = (b % 2 == 0) ? invfac[a]*invfac[b] : -invfac[a]*invfac[b];
+						used[col - base_col] = 1;
+						if(iidx[k] < 0){
+							work[col - base_col] = work[col - base_col] + ivals[k]*T(coef);
+							mag[col - base_col] += std::abs(ivals[k])*std::abs(coef);
+						}else{
+							term.col = col;
+							term.idx = iidx[k];
+							term.kind = ikind[k];
+							term.coef = ivals[k]*T(coef);
+							terms.push_back(term);
+						}
+					}
+				}
+			}
+
+			std::sort(terms.begin(), terms.end());
+
+			cnt = 0;
+			t = 0;
+
+			for(S w = 0; w < MaxRowSize(); w++){
+				if(used[w]){
+					cols[cnt] = base_col + w;
+					base[cnt] = (std::abs(work[w]) > tol*mag[w]) ? work[w] : T(0);
+					nterm[cnt] = 0;
+					tmag = 0.0;
+					//the terms of the same eigenvalue part are merged
+					while(t < (S)terms.size() && terms[t].col == base_col + w){
+						if(nterm[cnt] > 0 && tidx.back() == terms[t].idx && tkind.back() == terms[t].kind){
+							tcoef.back() = tcoef.back() + terms[t].coef;
+							tmag += std::abs(terms[t].coef);
+						}else{
+							FlushCoef(tcoef, nterm[cnt], tmag);
+							tidx.push_back(terms[t].idx);
+							tkind.push_back(terms[t].kind);
+							tcoef.push_back(terms[t].coef);
+							tmag = std::abs(terms[t].coef);
+							nterm[cnt]++;
+						}
+						t++;
+					}
+					FlushCoef(tcoef, nterm[cnt], tmag);
+					cnt++;
+					work[w] = T(0);
+					mag[w] = 0.0;
+					used[w] = 0;
+				}
+			}
+
+			return cnt;
+		};
+};
+
+#endif
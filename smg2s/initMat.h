@@ -0,0 +1,260 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __INIT_MAT_H__
+#define __INIT_MAT_H__
+
+#include "../parVector/parVector.h"
+#include "../utils/philox.h"
+#include <complex>
+#include <cmath>
+
+/*Rows of the initial matrix A0 = lower band + given spectrum, before the similarity
+  transform. The eigenvalues are known for the rows [lower, upper) of the given vector,
+  so a row r can be built on its own as long as its eigenvalues lie in this window.
+  Without vector (NULL), only the pattern is given: all the values are 1, and in the
+  non symmetric case all the eigenvalues are taken as complex.
+
+  The values of the lower band are scale * Value(row, col) of the band distribution given to the
+  constructor, the one of the run by default (see utils/philox.h), with the scale 1 in the non
+  Hermitian case and 0.01 in the non symmetric case. They only depend on (seed, row, col), so a
+  row is the same whichever proc builds it. For a complex T, only the real part is random, the
+  imaginary part of the band is 0.
+
+  SymRow gives the same row split into what depends on the spectrum or not: an entry with
+  idx = -1 is the value itself, otherwise the value times the part kind of the eigenvalue idx,
+  which Eval returns. The pattern of SymRow is the one of the pattern mode*/
+
+//part of the eigenvalue an entry of the initial matrix depends on
+enum specPart {SPEC_VALUE, SPEC_REAL, SPEC_ABSIMAG};
+
+/*Non Hermitian case: lower band of width lbandwidth and the eigenvalues on the diagonal*/
+template<typename T, typename S>
+class initMatNonHerm
+{
+	private:
+		S	probSize, lbandwidth;
+		S	lower, upper;
+		T	*spec;
+		bandRandom	band;
+
+	public:
+		initMatNonHerm(S size, S lband, parVector<T,S> *vec, bandRandom band_in = bandSetting()){
+			probSize = size;
+			lbandwidth = lband;
+			lower = 0;
+			upper = size;
+			spec = NULL;
+			if(vec != NULL){
+				lower = vec->GetLowerBound();
+				upper = vec->GetUpperBound();
+				spec = vec->GetArray();
+			}
+			band = band_in;
+		};
+
+		//the columns of row r lie in [r - LowerBand(), r + UpperBand()]
+		S	LowerBand(){return lbandwidth;};
+		S	UpperBand(){return 0;};
+		S	MaxRowSize(){return lbandwidth + 1;};
+
+		//first and last + 1 row whose eigenvalues are needed to build the rows [r0, r1)
+		S	SpecLower(S r0){return r0;};
+		S	SpecUpper(S r1){return r1;};
+
+		//row r with increasing cols, returns the number of entries
+		S	Row(S r, S *cols, T *vals){
+
+			T rnd;
+			S cnt = 0;
+
+			for(S j = r - lbandwidth; j < r; j++){
+				if(j >= 0){
+					rnd = (spec != NULL) ? T(band.Value(r, j)) : T(1);
+					cols[cnt] = j;
+					vals[cnt] = rnd;
+					cnt++;
+				}
+			}
+
+			cols[cnt] = r;
+			vals[cnt] = (spec != NULL) ? spec[r - lower] : T(1);
+			cnt++;
+
+			return cnt;
+		};
+
+		S	SymRow(S r, S *cols, T *vals, S *idx, char *kind){
+
+			S cnt = 0;
+
+			for(S j = r - lbandwidth; j < r; j++){
+				if(j >= 0){
+					cols[cnt] = j;
+					vals[cnt] = T(band.Value(r, j));
+					idx[cnt] = -1;
+					cnt++;
+				}
+			}
+
+			cols[cnt] = r;
+			vals[cnt] = 1;
+			idx[cnt] = r;
+			kind[cnt] = SPEC_VALUE;
+			cnt++;
+
+			return cnt;
+		};
+
+		T	Eval(S i, char){return spec[i - lower];};
+};
+
+/*Non symmetric case: lower band of width lbandwidth without the first sub-diagonal, and the
+  real 2x2 blocks of the conjugate pairs (r, r+1), r even, on the diagonal. An odd row needs
+  the eigenvalue of the row above, which is prev if it lies out of the window*/
+template<typename T, typename S>
+class initMatNonSym
+{
+	private:
+		S	probSize, lbandwidth;
+		S	lower, upper;
+		std::complex<T>	*spec;
+		std::complex<T>	prev;
+		bandRandom	band;
+
+	public:
+		initMatNonSym(S size, S lband, parVector<std::complex<T>,S> *vec, std::complex<T> prev_in = 0, bandRandom band_in = bandSetting()){
+			probSize = size;
+			lbandwidth = lband;
+			lower = 0;
+			upper = size;
+			spec = NULL;
+			if(vec != NULL){
+				lower = vec->GetLowerBound();
+				upper = vec->GetUpperBound();
+				spec = vec->GetArray();
+			}
+			prev = prev_in;
+			band = band_in;
+		};
+
+		S	LowerBand(){return lbandwidth;};
+		S	UpperBand(){return 1;};
+		S	MaxRowSize(){return lbandwidth + 2;};
+
+		S	SpecLower(S r0){return (r0 > 0) ? r0 - 1 : 0;};
+		S	SpecUpper(S r1){return r1;};
+
+		S	Row(S r, S *cols, T *vals){
+
+			T rnd;
+			S cnt = 0;
+			std::complex<T> pair, diag;
+
+			for(S j = r - lbandwidth; j < r - 1; j++){
+				if(j >= 0){
+					rnd = (spec != NULL) ? T(0.01 * band.Value(r, j)) : T(0.01);
+					cols[cnt] = j;
+					vals[cnt] = rnd;
+					cnt++;
+				}
+			}
+
+			if(spec != NULL){
+				diag = spec[r - lower];
+				pair = (r - 1 >= lower) ? spec[r - 1 - lower] : prev;
+			}else{
+				diag = std::complex<T>(1, 1);
+				pair = diag;
+			}
+
+			if(r % 2 == 1){
+				if(pair.imag() != 0){
+					cols[cnt] = r - 1;
+					vals[cnt] = -std::abs(pair.imag());
+					cnt++;
+				}
+			}
+
+			cols[cnt] = r;
+			vals[cnt] = diag.real();
+			cnt++;
+
+			if(r % 2 == 0 && r < probSize - 1){
+				if(diag.imag() != 0){
+					cols[cnt] = r + 1;
+					vals[cnt] = std::abs(diag.imag());
+					cnt++;
+				}
+			}
+
+			return cnt;
+		};
+
+		S	SymRow(S r, S *cols, T *vals, S *idx, char *kind){
+
+			S cnt = 0;
+
+			for(S j = r - lbandwidth; j < r - 1; j++){
+				if(j >= 0){
+					cols[cnt] = j;
+					vals[cnt] = T(0.01 * band.Value(r, j));
+					idx[cnt] = -1;
+					cnt++;
+				}
+			}
+
+			if(r % 2 == 1){
+				cols[cnt] = r - 1;
+				vals[cnt] = -1;
+				idx[cnt] = r - 1;
+				kind[cnt] = SPEC_ABSIMAG;
+				cnt++;
+			}
+
+			cols[cnt] = r;
+			vals[cnt] = 1;
+			idx[cnt] = r;
+			kind[cnt] = SPEC_REAL;
+			cnt++;
+
+			if(r % 2 == 0 && r < probSize - 1){
+				cols[cnt] = r + 1;
+				vals[cnt] = 1;
+				idx[cnt] = r;
+				kind[cnt] = SPEC_ABSIMAG;
+				cnt++;
+			}
+
+			return cnt;
+		};
+
+		T	Eval(S i, char kind){
+			std::complex<T> val = (i >= lower) ? spec[i - lower] : prev;
+			return (kind == SPEC_REAL) ? val.real() : std::abs(val.imag());
+		};
+};
+
+#endif
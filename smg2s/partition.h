@@ -0,0 +1,244 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __PARTITION_H__
+#define __PARTITION_H__
+
+#include <mpi.h>
+#include <math.h>
+#include <vector>
+#include "../utils/utils.h"
+#include "../utils/MPI_DataType.h"
+#include "initMat.h"
+#include "directGen.h"
+
+/*Number of nonzeros of each row of the generated matrix, from (probSize, lbandwidth, nilp) only.
+
+  The pattern of a row i is the one of the closed form (see directGen.h) applied to the pattern of
+  the initial matrix. Away from the first lbandwidth rows and from the last rows reached by the
+  shifts, it only depends on i modulo 2*(nbOne+1): the zeros of the nilpotent matrix come back
+  every nbOne+1 rows and the 2x2 blocks of the non symmetric case every 2 rows. So only the rows
+  of the head, of one period and of the tail are built, and the nnz of the rows [0, i) is given in
+  O(1) by their prefix sums*/
+template<typename S>
+class rowNnzModel
+{
+	private:
+		S	probSize;
+		S	head, tail, period;
+
+		//prefix sums of the nnz on the head rows [0, head), on one period from head, and on the tail rows [tail, probSize)
+		std::vector<double>	headPre, perPre, tailPre;
+
+		template<class Init>
+		void Count(Nilpotency<S> nilp, Init &A0){
+
+			directGen<double,S> gen(nilp, probSize, A0);
+
+			S	margin = A0.LowerBand() + period;
+			S	reach = 2*gen.RowHalo() + A0.UpperBand() + nilp.diagPosition + 1;
+
+			head = (margin < probSize) ? margin : probSize;
+			tail = (probSize - reach > head + period) ? probSize - reach : head;
+
+			//too small to have a periodic part
+			if(tail == head){
+				head = probSize;
+				tail = probSize;
+			}
+
+			headPre.assign(head + 1, 0.0);
+			for(S i = 0; i < head; i++){
+				headPre[i + 1] = headPre[i] + gen.RowSize(i, A0);
+			}
+
+			perPre.assign(period + 1, 0.0);
+			if(tail > head){
+				for(S i = 0; i < period; i++){
+					perPre[i + 1] = perPre[i] + gen.RowSize(head + i, A0);
+				}
+			}
+
+			tailPre.assign(probSize - tail + 1, 0.0);
+			for(S i = tail; i < probSize; i++){
+				tailPre[i - tail + 1] = tailPre[i - tail] + gen.RowSize(i, A0);
+			}
+		};
+
+	public:
+		rowNnzModel(S size, Nilpotency<S> nilp, S lbandwidth, bool nonsym){
+			probSize = size;
+			period = 2*(nilp.nbOne + 1);
+
+			if(nonsym){
+				initMatNonSym<double,S> A0(probSize, lbandwidth, NULL);
+				Count(nilp, A0);
+			}else{
+				initMatNonHerm<double,S> A0(probSize, lbandwidth, NULL);
+				Count(nilp, A0);
+			}
+		};
+
+		//nnz of the rows [0, i)
+		double Prefix(S i){
+			double	nnz;
+
+			if(i <= head){
+				return headPre[i];
+			}
+
+			if(i <= tail){
+				nnz = headPre[head];
+				nnz = nnz + double((i - head)/period)*perPre[period];
+				nnz = nnz + perPre[(i - head)%period];
+				return nnz;
+			}
+
+			return Prefix(tail) + tailPre[i - tail];
+		};
+
+		//first row i such that Prefix(i) >= target
+		S Search(double target){
+			S	lo = 0, hi = probSize, mid;
+
+			while(lo < hi){
+				mid = lo + (hi - lo)/2;
+				if(Prefix(mid) < target){
+					lo = mid + 1;
+				}else{
+					hi = mid;
+				}
+			}
+			return lo;
+		};
+};
+
+
+//rows [lower_b, upper_b) of the proc rank, with the former split of ceil(probSize/nprocs) rows per proc
+template<typename S>
+void equalRowsBounds(S probSize, int nprocs, int rank, S &lower_b, S &upper_b){
+
+	S span = S(ceil(double(probSize)/double(nprocs)));
+
+	if(rank == nprocs - 1){
+		lower_b = rank * span;
+		upper_b = probSize - 1 + 1;
+	}else{
+		lower_b = rank * span;
+		upper_b = (rank + 1) * span - 1 + 1;
+	}
+}
+
+
+//rows [lower_b, upper_b) of the proc rank, with about the same nnz on each proc
+template<typename S>
+void nnzBalancedBounds(rowNnzModel<S> &model, S probSize, int nprocs, int rank, S &lower_b, S &upper_b){
+
+	double total = model.Prefix(probSize);
+
+	lower_b = (rank == 0) ? 0 : model.Search(total*double(rank)/double(nprocs));
+	upper_b = (rank == nprocs - 1) ? probSize : model.Search(total*double(rank + 1)/double(nprocs));
+}
+
+
+/*Row partition of the generated matrix among the procs of comm. With nnzBalance, each proc gets a
+  contiguous range of rows with about the same number of nonzeros, from the nnz model above,
+  otherwise the rows are split evenly. The load imbalance (max/average nnz per proc) predicted by
+  the model is reported by the proc 0 for both partitions. The model is given by the caller,
+  which may need it as well*/
+template<typename S>
+void rowPartition(rowNnzModel<S> &model, S probSize, bool nnzBalance, MPI_Comm comm, S &lower_b, S &upper_b){
+
+	int nprocs, rank;
+
+	MPI_Comm_size(comm, &nprocs);
+	MPI_Comm_rank(comm, &rank);
+
+	if(!nnzBalance){
+		equalRowsBounds(probSize, nprocs, rank, lower_b, upper_b);
+		return;
+	}
+
+	nnzBalancedBounds(model, probSize, nprocs, rank, lower_b, upper_b);
+
+	if(rank == 0){
+		double	total = model.Prefix(probSize);
+		S		lb, ub;
+		double	max_rows = 0, max_nnz = 0, nnz;
+
+		for(int p = 0; p < nprocs; p++){
+			equalRowsBounds(probSize, nprocs, p, lb, ub);
+			nnz = model.Prefix(ub) - model.Prefix(lb);
+			max_rows = (nnz > max_rows) ? nnz : max_rows;
+
+			nnzBalancedBounds(model, probSize, nprocs, p, lb, ub);
+			nnz = model.Prefix(ub) - model.Prefix(lb);
+			max_nnz = (nnz > max_nnz) ? nnz : max_nnz;
+		}
+
+		printf("Row partition balanced on nnz: predicted load imbalance (max/avg nnz) = %1.3f, %1.3f with the even split of rows\n", max_nnz*nprocs/total, max_rows*nprocs/total);
+	}
+}
+
+//same, the model is only built for nnzBalance
+template<typename S>
+void rowPartition(S probSize, Nilpotency<S> nilp, S lbandwidth, bool nonsym, bool nnzBalance, MPI_Comm comm, S &lower_b, S &upper_b){
+
+	int nprocs, rank;
+
+	if(!nnzBalance){
+		MPI_Comm_size(comm, &nprocs);
+		MPI_Comm_rank(comm, &rank);
+
+		equalRowsBounds(probSize, nprocs, rank, lower_b, upper_b);
+		return;
+	}
+
+	rowNnzModel<S> model(probSize, nilp, lbandwidth, nonsym);
+
+	rowPartition(model, probSize, nnzBalance, comm, lower_b, upper_b);
+}
+
+
+//measured load imbalance (max/avg local nnz) of the generated matrix, reported by the proc 0
+template<typename S>
+void reportImbalance(S nnz_loc, MPI_Comm comm){
+
+	int nprocs, rank;
+
+	MPI_Comm_size(comm, &nprocs);
+	MPI_Comm_rank(comm, &rank);
+
+	S nnz_max, nnz_sum;
+
+	MPI_Reduce(&nnz_loc, &nnz_max, 1, MPI_Index<S>(), MPI_MAX, 0, comm);
+	MPI_Reduce(&nnz_loc, &nnz_sum, 1, MPI_Index<S>(), MPI_SUM, 0, comm);
+
+	if(rank == 0 && nnz_sum > 0){
+		printf("Load imbalance of the generated matrix (max/avg nnz) = %1.3f\n", double(nnz_max)*nprocs/double(nnz_sum));
+	}
+}
+
+#endif
@@ -29,6 +29,7 @@ SOFTWARE.
 #include "../parVector/parVector.h"
 #include "../parMatrix/parMatrixSparse.h"
 #include "specGen.h"
+#include "partition.h"
 #include <math.h>
 #include <complex.h>
 #include <string>
@@ -40,8 +41,8 @@ SOFTWARE.
 #include <malloc.h>
 #endif
 
-template<typename T, typename S>
-parMatrixSparse<T,S> *smg2s(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm){
+template<typename T, typename S, typename R = std::map<S,T> >
+parMatrixSparse<T,S,R> *smg2s(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, bool nnzBalance = false, bool timeGlobalInit = false){
 
 	int world_size;
 	int world_rank;
@@ -53,35 +54,26 @@ parMatrixSparse<T,S> *smg2s(S probSize, Nilpotency<S> nilp, S lbandwidth, std::s
 	 // Get the rank of the process
     MPI_Comm_rank(comm, &world_rank);
 
-    S span, lower_b, upper_b;
+    S lower_b, upper_b;
 
-    span = S(ceil(double(probSize)/double(world_size)));
-
-    if(world_rank == world_size - 1){
-		lower_b = world_rank * span;
-		upper_b = probSize - 1 + 1;
-    }else{
-		lower_b = world_rank * span;
-		upper_b = (world_rank + 1) * span - 1 + 1;
-    }
+    rowPartition(probSize, nilp, lbandwidth, false, nnzBalance, comm, lower_b, upper_b);
 
 
-	parVector<T,S> *vec = new parVector<T,S>(comm, lower_b, upper_b);
+    //the temporaries are released at the return, Am keeps the map of vec
+    parVector<T,S> vec(comm, lower_b, upper_b);
 
 
     MPI_Barrier(comm);
 
     //generate vec containing the given spectra
 
-    vec->specGen(spectrum);
+    vec.specGen(spectrum);
     
 
-    //Matrix Initialization
+    //Matrix Initialization, Am is returned to the caller who deletes it
 
-    parMatrixSparse<T,S> *Am = new parMatrixSparse<T,S>(vec,vec);
-    parMatrixSparse<T,S> *MA = new parMatrixSparse<T,S>(vec,vec);
-    parMatrixSparse<T,S> *AM = new parMatrixSparse<T,S>(vec,vec);
-    parMatrixSparse<T,S> *matAop = new parMatrixSparse<T,S>(vec,vec);
+    parMatrixSparse<T,S,R> *Am = new parMatrixSparse<T,S,R>(&vec,&vec);
+    parMatrixSparse<T,S,R> matAop(&vec,&vec);
 
     MPI_Barrier(comm);
 
@@ -89,50 +81,76 @@ parMatrixSparse<T,S> *smg2s(S probSize, Nilpotency<S> nilp, S lbandwidth, std::s
 
     start = MPI_Wtime();
 
-    matInit(Am, matAop, probSize, lbandwidth);
-    Am->Loc_SetDiagonal(vec);
-    matAop->Loc_SetDiagonal(vec);
- 
+    matInitLoc(Am, &matAop, probSize, lbandwidth, &vec);
+
     end = MPI_Wtime();
 
     double t2 = end - start;
+    double t2_max;
 
-    if(world_rank == 0) {printf("Initial matrix generation time = %1.6f\n", t2);}
+    //the initialization only visits the local rows, so its work shrinks with the number of procs
+    S nrows_loc = upper_b - lower_b, nrows_max;
 
-    MPI_Barrier(comm);
+    MPI_Reduce(&t2, &t2_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&nrows_loc, &nrows_max, 1, MPI_Index<S>(), MPI_MAX, 0, comm);
 
+    if(world_rank == 0) {
+        printf("Initial matrix generation time = %1.6f\n", t2_max);
+        printf("Initial matrix generation local row reduction factor = %1.2f (%d procs, max local rows = %ld)\n", double(probSize)/double(nrows_max), world_size, (long)nrows_max);
+    }
 
-    __int64_t my_factorielle_bornes = 1;
+    //with timeGlobalInit, the former sweep over all the probSize rows on every proc is timed too,
+    //into matrices which are thrown away, for the measured speedup of the local initialization
+    if(timeGlobalInit){
+        double t_old, t_old_max;
 
-    my_factorielle_bornes = factorial(1,2*nilp.nbOne);
+        {
+            parMatrixSparse<T,S,R> A_old(&vec,&vec);
+            parMatrixSparse<T,S,R> Aop_old(&vec,&vec);
 
-    Am->Loc_MatScale((T)my_factorielle_bornes);
+            MPI_Barrier(comm);
 
-    for (S k=1; k<=2*nilp.nbOne; k++){
+            start = MPI_Wtime();
 
-    	matAop->MA(nilp, MA);
-  	    matAop->AM(nilp, AM);
-    	matAop->Loc_MatAYPX(AM, 0);
-    	matAop->Loc_MatAXPY(MA, -1);
+            matInit(&A_old, &Aop_old, probSize, lbandwidth);
+            A_old.Loc_SetDiagonal(&vec);
+            Aop_old.Loc_SetDiagonal(&vec);
 
-  	    my_factorielle_bornes = factorial(k+1,2*nilp.nbOne);
-    	Am->Loc_MatAXPY(matAop, (double)my_factorielle_bornes);
-    	MA->Loc_ZeroEntries();
-    	AM->Loc_ZeroEntries();
+            t_old = MPI_Wtime() - start;
+        }
 
+        MPI_Reduce(&t_old, &t_old_max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+        if(world_rank == 0) {
+            printf("Initial matrix generation time of the global row sweep = %1.6f, measured speedup = %1.2f\n", t_old_max, (t2_max > 0) ? t_old_max/t2_max : 0.0);
+        }
     }
 
+    MPI_Barrier(comm);
+
+
+    //1/k! for k = 0..2*nbOne, computed once: the coefficients are folded into the accumulation,
+    //no scaling of Am before and after the loop
+    std::vector<double> invfac = invFactorials(2*nilp.nbOne);
+
+    //matAop <- AM - MA and Am <- Am + 1/k! * matAop, fused in a single sweep
+
+    for (S k=1; k<=2*nilp.nbOne; k++){
+
+    	matAop.FusedAMMA(nilp, Am, (T)invfac[k]);
 
-	my_factorielle_bornes = factorial(1,2*(nilp.nbOne));
+    }
 
-    double fac = (double)my_factorielle_bornes;
-    double inv = 1/fac;
+    //the entries of Am which cancelled out in the accumulation are removed, so that its
+    //nnz is the real one; matAop holds no explicit zeros, FusedAMMA drops them
 
-	Am->Loc_MatScale((T)inv);
+    Am->Loc_Prune();
 
     //Am->LOC_MatView();
   
 
+    reportImbalance(Am->GetLocNnz(), comm);
+
     return Am;
 }
 
@@ -0,0 +1,139 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_DIA_H__
+#define __SMG2S_DIA_H__
+
+#include "../parVector/parVector.h"
+#include "../parMatrix/parMatrixDIA.h"
+#include "specGen.h"
+#include "specGen_nonsymmetric.h"
+#include "initMat.h"
+#include "partition.h"
+#include <complex>
+#include <string>
+
+/*smg2s() and smg2s_nonsymmetric() on the DIA storage of parMatrixDIA.h.
+
+  The initial matrix A0 has the diagonals [-lbandwidth, UpperBand()] and each AM - MA moves them up
+  by shift = diagPosition - 1, so ad^k(A0) has the diagonals [-lbandwidth + k*shift, UpperBand() + k*shift]
+  and Am = sum_k 1/k! ad^k(A0) the diagonals [-lbandwidth, UpperBand() + 2*nbOne*shift]. Both are
+  allocated once with these diagonals and the loop only sweeps dense arrays, without any insert*/
+
+//generation loop on the DIA storage from the initial matrix A0, rows of vec
+template<typename T, typename S, class Init>
+parMatrixDIA<T,S> *diaGen(S probSize, Nilpotency<S> nilp, Init &A0, parVector<T,S> *vec){
+
+	S shift = nilp.diagPosition - 1;
+
+	S dmin = -A0.LowerBand();
+	S dmax = A0.UpperBand() + 2*nilp.nbOne*shift;
+
+	//no diagonal out of the matrix
+	dmin = (dmin < 1 - probSize) ? 1 - probSize : dmin;
+	dmax = (dmax > probSize - 1) ? probSize - 1 : dmax;
+
+	S bmax = (A0.UpperBand() > dmax) ? dmax : A0.UpperBand();
+
+	parMatrixDIA<T,S> *Am = new parMatrixDIA<T,S>(vec, dmin, dmax);
+	parMatrixDIA<T,S> matAop(vec, dmin, bmax);
+
+	S lower_b = vec->GetLowerBound();
+	S upper_b = vec->GetUpperBound();
+
+	S *cols = new S[A0.MaxRowSize()];
+	T *vals = new T[A0.MaxRowSize()];
+
+	S cnt;
+
+	for(S i = lower_b; i < upper_b; i++){
+		cnt = A0.Row(i, cols, vals);
+
+		Am->Loc_SetRowLocal(i - lower_b, cnt, cols, vals);
+		matAop.Loc_SetRowLocal(i - lower_b, cnt, cols, vals);
+	}
+
+	delete [] cols;
+	delete [] vals;
+
+	std::vector<double> invfac = invFactorials(2*nilp.nbOne);
+
+	for(S k = 1; k <= 2*nilp.nbOne; k++){
+		matAop.FusedAMMA(nilp, Am, (T)invfac[k]);
+	}
+
+	return Am;
+}
+
+
+//smg2s() with the generated matrix in DIA storage
+template<typename T, typename S>
+parMatrixDIA<T,S> *smg2s_dia(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, bool nnzBalance = false){
+
+	S lower_b, upper_b;
+
+	rowPartition(probSize, nilp, lbandwidth, false, nnzBalance, comm, lower_b, upper_b);
+
+	parVector<T,S> vec(comm, lower_b, upper_b);
+
+	vec.specGen(spectrum);
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, &vec);
+
+	parMatrixDIA<T,S> *Am = diaGen<T,S>(probSize, nilp, A0, &vec);
+
+	reportImbalance(Am->GetLocNnz(), comm);
+
+	return Am;
+}
+
+
+//smg2s_nonsymmetric() with the generated matrix in DIA storage
+template<typename T, typename S>
+parMatrixDIA<T,S> *smg2s_nonsymmetric_dia(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, bool nnzBalance = false){
+
+	S lower_b, upper_b, spec_lb;
+
+	rowPartition(probSize, nilp, lbandwidth, true, nnzBalance, comm, lower_b, upper_b);
+
+	parVector<T,S> vec(comm, lower_b, upper_b);
+
+	//an odd first row needs the eigenvalue of the row above
+	spec_lb = (lower_b > 0) ? lower_b - 1 : 0;
+
+	parVector<std::complex<T>,S> spec(comm, spec_lb, upper_b);
+
+	spec.specGen2(spectrum);
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, &spec);
+
+	parMatrixDIA<T,S> *Am = diaGen<T,S>(probSize, nilp, A0, &vec);
+
+	reportImbalance(Am->GetLocNnz(), comm);
+
+	return Am;
+}
+
+#endif
@@ -0,0 +1,230 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_DIRECT_H__
+#define __SMG2S_DIRECT_H__
+
+#include "../parVector/parVector.h"
+#include "../parMatrix/parMatrixSparse.h"
+#include "specGen.h"
+#include "specGen_nonsymmetric.h"
+#include "initMat.h"
+#include "directGen.h"
+#include "partition.h"
+#include <math.h>
+#include <complex>
+#include <string>
+#include <vector>
+
+//fill the local rows of Am from the closed form
+template<typename T, typename S, typename R, class Init>
+void directFill(parMatrixSparse<T,S,R> *Am, Nilpotency<S> nilp, S probSize, Init &A0){
+
+	S lower_b = Am->GetYLowerBound();
+	S upper_b = Am->GetYUpperBound();
+
+	directGen<T,S> gen(nilp, probSize, A0);
+
+	S *cols = new S[gen.MaxRowSize()];
+	T *vals = new T[gen.MaxRowSize()];
+
+	S cnt;
+
+	for(S i = lower_b; i < upper_b && i < probSize; i++){
+		cnt = gen.Row(i, A0, cols, vals);
+		Am->Loc_SetRowLocal(i - lower_b, cnt, cols, vals);
+	}
+
+	delete [] cols;
+	delete [] vals;
+}
+
+
+//same as smg2s(), but the matrix is assembled from the closed form without the 2*nbOne iterations
+template<typename T, typename S, typename R = std::map<S,T> >
+parMatrixSparse<T,S,R> *smg2s_direct(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, bool nnzBalance = false){
+
+	S lower_b, upper_b, spec_lb, spec_ub;
+
+	rowPartition(probSize, nilp, lbandwidth, false, nnzBalance, comm, lower_b, upper_b);
+
+	parVector<T,S> vec(comm, lower_b, upper_b);
+
+	//the eigenvalues of the rows below the local ones are needed too, the windows of the procs overlap
+	spec_lb = lower_b;
+	spec_ub = upper_b + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<T,S> spec(comm, spec_lb, spec_ub);
+
+	spec.specGen(spectrum);
+
+	parMatrixSparse<T,S,R> *Am = new parMatrixSparse<T,S,R>(&vec,&vec);
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, &spec);
+
+	directFill(Am, nilp, probSize, A0);
+
+	reportImbalance(Am->GetLocNnz(), comm);
+
+	return Am;
+}
+
+
+//same as smg2s_nonsymmetric(), but the matrix is assembled from the closed form
+template<typename T, typename S, typename R = std::map<S,T> >
+parMatrixSparse<T,S,R> *smg2s_nonsymmetric_direct(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, bool nnzBalance = false){
+
+	S lower_b, upper_b, spec_lb, spec_ub;
+
+	rowPartition(probSize, nilp, lbandwidth, true, nnzBalance, comm, lower_b, upper_b);
+
+	parVector<T,S> vec(comm, lower_b, upper_b);
+
+	//an odd row needs the eigenvalue of the row above for its 2x2 block
+	spec_lb = (lower_b > 0) ? lower_b - 1 : 0;
+	spec_ub = upper_b + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<std::complex<T>,S> spec(comm, spec_lb, spec_ub);
+
+	spec.specGen2(spectrum);
+
+	parMatrixSparse<T,S,R> *Am = new parMatrixSparse<T,S,R>(&vec,&vec);
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, &spec);
+
+	directFill(Am, nilp, probSize, A0);
+
+	reportImbalance(Am->GetLocNnz(), comm);
+
+	return Am;
+}
+
+
+//rows [r0, r1) of the closed form as a CSR block, row offsets start from 0 and cols are global
+template<typename T, typename S, class Init>
+MatrixCSR<T,S> *directRows(directGen<T,S> &gen, Init &A0, S probSize, S r0, S r1){
+
+	MatrixCSR<T,S> *csr = new MatrixCSR<T,S>((r1 - r0)*(A0.MaxRowSize() + gen.RowHalo()), r1 - r0);
+
+	csr->ncols = probSize;
+
+	S *cols = new S[gen.MaxRowSize()];
+	T *vals = new T[gen.MaxRowSize()];
+
+	S cnt, count = 0;
+
+	for(S i = r0; i < r1; i++){
+		csr->rows.push_back(count);
+		cnt = gen.Row(i, A0, cols, vals);
+		for(S k = 0; k < cnt; k++){
+			if(vals[k] != T(0)){
+				csr->cols.push_back(cols[k]);
+				csr->vals.push_back(vals[k]);
+				count++;
+			}
+		}
+	}
+	csr->rows.push_back(count);
+
+	csr->nnz = count;
+
+	delete [] cols;
+	delete [] vals;
+
+	return csr;
+}
+
+
+/*Rows [r0, r1) of the non Hermitian matrix given by (probSize, nilp, lbandwidth, spectrum), the same
+  as the ones of smg2s() whatever the number of procs. Only the eigenvalues of the rows [r0, r1 + 2*nbOne*s)
+  are generated on the calling proc, without any communication, so that the blocks can be pulled one
+  by one without holding the whole matrix. Returns NULL if the range is not valid*/
+template<typename T, typename S>
+MatrixCSR<T,S> *smg2s_rows(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, S r0, S r1){
+
+	if(r0 < 0 || r1 > probSize || r0 > r1){
+		printf("ERROR ]> The row range [%ld, %ld) is out of [0, %ld)\n", (long)r0, (long)r1, (long)probSize);
+		return NULL;
+	}
+
+	S spec_lb, spec_ub;
+
+	spec_lb = r0;
+	spec_ub = r1 + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<T,S> spec(MPI_COMM_SELF, spec_lb, spec_ub);
+
+	spec.specGen(spectrum);
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, &spec);
+
+	directGen<T,S> gen(nilp, probSize, A0);
+
+	MatrixCSR<T,S> *csr = directRows(gen, A0, probSize, r0, r1);
+
+	return csr;
+}
+
+
+//rows [r0, r1) of the non symmetric matrix, the same as the ones of smg2s_nonsymmetric()
+template<typename T, typename S>
+MatrixCSR<T,S> *smg2s_nonsymmetric_rows(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, S r0, S r1){
+
+	if(r0 < 0 || r1 > probSize || r0 > r1){
+		printf("ERROR ]> The row range [%ld, %ld) is out of [0, %ld)\n", (long)r0, (long)r1, (long)probSize);
+		return NULL;
+	}
+
+	S spec_lb, spec_ub;
+
+	spec_lb = (r0 > 0) ? r0 - 1 : 0;
+	spec_ub = r1 + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<std::complex<T>,S> spec(MPI_COMM_SELF, spec_lb, spec_ub);
+
+	spec.specGen2(spectrum);
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, &spec);
+
+	directGen<T,S> gen(nilp, probSize, A0);
+
+	MatrixCSR<T,S> *csr = directRows(gen, A0, probSize, r0, r1);
+
+	return csr;
+}
+
+#endif
@@ -0,0 +1,273 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_ENSEMBLE_H__
+#define __SMG2S_ENSEMBLE_H__
+
+#include "smg2s_direct.h"
+#include "smg2s_stream.h"
+#include "partition.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*Ensemble generation: many matrices of moderate size in a single run.
+
+  The procs of comm are split into groups of groupSize procs with MPI_Comm_split. The jobs are
+  taken one by one by the groups from a shared counter on the proc 0 of comm (MPI_Fetch_and_op),
+  so that a group which is done with a small matrix takes the next job at once. The job index is
+  broadcast in the group, then each proc of the group builds its rows of the matrix as a CSR block
+  with smg2s_rows(), on its own: there is no other communication per matrix.
+
+  The block is handed to a sink called as sink(id, job, r0, block, gcomm), with the index of the
+  job, the global index r0 of the first row of the block and the communicator of the group, then
+  freed*/
+
+//one matrix of an ensemble
+template<typename S>
+struct smg2sJob
+{
+	S				probSize;
+	S				lbandwidth;
+	Nilpotency<S>	nilp;
+	std::string		spectrum;
+};
+
+
+/*jobs from a text file, one per line "SIZE L C [DIAGP [SPECTRUM_FILE]]", with the nilpotent matrix of
+  NilpType1 for DIAGP = 2 (default), of NilpType3 otherwise. The lines starting with % are skipped*/
+template<typename S>
+std::vector<smg2sJob<S> > readJobs(std::string file){
+
+	std::ifstream in(file.c_str());
+	std::string line;
+
+	std::vector<smg2sJob<S> > jobs;
+
+	long size, lband, nbOne, diagP;
+	std::string spectrum;
+
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	if(!in.is_open()){
+		if(rank == 0){
+			printf("ERROR ]> Cannot open the job file %s\n", file.c_str());
+		}
+		return jobs;
+	}
+
+	while(std::getline(in, line)){
+		if(line.empty() || line[0] == '%'){
+			continue;
+		}
+
+		std::stringstream linestream(line);
+
+		size = 0; lband = 0; nbOne = 0; diagP = 2;
+		spectrum = " ";
+
+		linestream >> size >> lband >> nbOne;
+		if(linestream.fail()){
+			continue;
+		}
+		linestream >> diagP >> spectrum;
+
+		smg2sJob<S> job;
+
+		job.probSize = size;
+		job.lbandwidth = lband;
+		job.spectrum = spectrum;
+
+		if(diagP == 2){
+			job.nilp.NilpType1(nbOne, size);
+		}else{
+			job.nilp.NilpType3(diagP, nbOne, size);
+		}
+
+		if(job.nilp.setup){
+			jobs.push_back(job);
+		}else if(rank == 0){
+			printf("ERROR ]> Skip the job \"%s\" of %s, the nilpotent matrix is not valid\n", line.c_str(), file.c_str());
+		}
+	}
+
+	return jobs;
+}
+
+
+/*sink writing each matrix of the ensemble into the files "prefix_id.rank", rank in the group, see
+  csrFileSink. The parameters of the job are written in a comment line of the header*/
+template<typename T, typename S>
+class ensembleFileSink
+{
+	private:
+		std::string	prefix;
+
+	public:
+		//number of entries received
+		S	nnz;
+
+		ensembleFileSink(std::string prefix_in){
+			prefix = prefix_in;
+			nnz = 0;
+		};
+
+		void operator()(S id, smg2sJob<S> &job, S r0, MatrixCSR<T,S> *block, MPI_Comm gcomm){
+			if(prefix.compare(" ") != 0){
+				std::stringstream name, comment;
+				name << prefix << "_" << id;
+				comment << "job " << id << ": SIZE " << job.probSize << " L " << job.lbandwidth << " C " << job.nilp.nbOne << " DIAGP " << job.nilp.diagPosition;
+				if(job.spectrum.compare(" ") != 0){
+					comment << " SPECTRUM " << job.spectrum;
+				}
+				csrFileSink<T,S> file(name.str(), job.probSize, gcomm, false, comment.str());
+				file(r0, block);
+			}
+			nnz = nnz + block->nnz;
+		};
+};
+
+
+//rows [r0, r1) of a job, non Hermitian and non symmetric cases
+template<typename T, typename S>
+struct nonHermRows
+{
+	MatrixCSR<T,S> *operator()(smg2sJob<S> &job, S r0, S r1){
+		return smg2s_rows<T,S>(job.probSize, job.nilp, job.lbandwidth, job.spectrum, r0, r1);
+	};
+};
+
+template<typename T, typename S>
+struct nonSymRows
+{
+	MatrixCSR<T,S> *operator()(smg2sJob<S> &job, S r0, S r1){
+		return smg2s_nonsymmetric_rows<T,S>(job.probSize, job.nilp, job.lbandwidth, job.spectrum, r0, r1);
+	};
+};
+
+
+//run the jobs with the dynamic queue, returns the number of jobs done by the group of the calling proc
+template<typename T, typename S, class Gen, class Sink>
+S ensembleRun(std::vector<smg2sJob<S> > &jobs, int groupSize, bool nonsym, bool nnzBalance, MPI_Comm comm, Gen gen, Sink &sink){
+
+	int rank, nprocs, grank, gsize;
+
+	MPI_Comm gcomm;
+	MPI_Win win;
+
+	long *counter;
+	long one = 1, next;
+
+	S lower_b, upper_b, done = 0, done_max, done_min, done_sum, done_lead;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &nprocs);
+
+	if(groupSize <= 0 || groupSize > nprocs){
+		groupSize = 1;
+	}
+
+	MPI_Comm_split(comm, rank / groupSize, rank, &gcomm);
+
+	MPI_Comm_rank(gcomm, &grank);
+	MPI_Comm_size(gcomm, &gsize);
+
+	//shared counter of the next job, on the proc 0
+	MPI_Win_allocate((rank == 0) ? sizeof(long) : 0, sizeof(long), MPI_INFO_NULL, comm, &counter, &win);
+
+	if(rank == 0){
+		MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+		*counter = 0;
+		MPI_Win_unlock(0, win);
+	}
+
+	MPI_Barrier(comm);
+
+	while(true){
+		if(grank == 0){
+			MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+			MPI_Fetch_and_op(&one, &next, MPI_LONG, 0, 0, MPI_SUM, win);
+			MPI_Win_unlock(0, win);
+		}
+
+		MPI_Bcast(&next, 1, MPI_LONG, 0, gcomm);
+
+		if(next >= (long)jobs.size()){
+			break;
+		}
+
+		smg2sJob<S> &job = jobs[next];
+
+		if(nnzBalance){
+			rowNnzModel<S> model(job.probSize, job.nilp, job.lbandwidth, nonsym);
+			nnzBalancedBounds(model, job.probSize, gsize, grank, lower_b, upper_b);
+		}else{
+			equalRowsBounds(job.probSize, gsize, grank, lower_b, upper_b);
+		}
+
+		MatrixCSR<T,S> *block = gen(job, lower_b, upper_b);
+
+		sink(S(next), job, lower_b, block, gcomm);
+
+		delete block;
+
+		done++;
+	}
+
+	MPI_Win_free(&win);
+
+	//jobs per group, counted once by the proc 0 of each group
+	done_lead = (grank == 0) ? done : 0;
+
+	MPI_Reduce(&done, &done_max, 1, MPI_Index<S>(), MPI_MAX, 0, comm);
+	MPI_Reduce(&done, &done_min, 1, MPI_Index<S>(), MPI_MIN, 0, comm);
+	MPI_Reduce(&done_lead, &done_sum, 1, MPI_Index<S>(), MPI_SUM, 0, comm);
+
+	if(rank == 0){
+		printf("Ensemble of %ld matrices generated by %d groups of at most %d procs, %ld to %ld matrices per group\n", (long)done_sum, (nprocs + groupSize - 1)/groupSize, groupSize, (long)done_min, (long)done_max);
+	}
+
+	MPI_Comm_free(&gcomm);
+
+	return done;
+}
+
+
+//ensemble of non Hermitian matrices
+template<typename T, typename S, class Sink>
+S smg2s_ensemble(std::vector<smg2sJob<S> > &jobs, int groupSize, MPI_Comm comm, Sink &sink, bool nnzBalance = false){
+	return ensembleRun<T,S>(jobs, groupSize, false, nnzBalance, comm, nonHermRows<T,S>(), sink);
+}
+
+
+//ensemble of non symmetric matrices
+template<typename T, typename S, class Sink>
+S smg2s_nonsymmetric_ensemble(std::vector<smg2sJob<S> > &jobs, int groupSize, MPI_Comm comm, Sink &sink, bool nnzBalance = false){
+	return ensembleRun<T,S>(jobs, groupSize, true, nnzBalance, comm, nonSymRows<T,S>(), sink);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_MIXED_H__
+#define __SMG2S_MIXED_H__
+
+#include "smg2s.h"
+#include "smg2s_nonsymmetric.h"
+#include <memory>
+
+/*Mixed precision generation: the matrix is generated in the accumulation type A, e.g. double or
+  std::complex<double>, and its local rows are only rounded to the output type T, e.g. float or
+  std::complex<float>, when they are emitted as CSR.
+
+  The 2*nbOne steps of AM - MA and the accumulation of the terms 1/k! * ad^k(A0) run in A, so the
+  rounding errors of these sums stay at the level of A, and the output costs the memory of T. The
+  entries which underflow to 0 in T are dropped. The peak memory is the one of the generation in A.
+
+  The local rows are returned as a CSR block of the type T, the row offsets start from 0 and the
+  cols are global, with the global index of the first row in r0, as for the blocks of
+  smg2s_stream(). The block belongs to the caller*/
+
+//smg2s() accumulated in A, emitted in T
+template<typename T, typename A, typename S, typename R = std::map<S,A> >
+MatrixCSR<T,S> *smg2s_mixed(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, S &r0, bool nnzBalance = false){
+
+	std::unique_ptr<parMatrixSparse<A,S,R> > Am(smg2s<A,S,R>(probSize, nilp, lbandwidth, spectrum, comm, nnzBalance));
+
+	r0 = Am->GetYLowerBound();
+
+	return Am->template Loc_AssembleCSR<S,T>();
+}
+
+
+//smg2s_nonsymmetric() accumulated in A, emitted in T, both real
+template<typename T, typename A, typename S, typename R = std::map<S,A> >
+MatrixCSR<T,S> *smg2s_nonsymmetric_mixed(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, S &r0, bool nnzBalance = false){
+
+	std::unique_ptr<parMatrixSparse<A,S,R> > Am(smg2s_nonsymmetric<A,S,R>(probSize, nilp, lbandwidth, spectrum, comm, nnzBalance));
+
+	r0 = Am->GetYLowerBound();
+
+	return Am->template Loc_AssembleCSR<S,T>();
+}
+
+#endif
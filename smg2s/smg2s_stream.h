@@ -0,0 +1,287 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_STREAM_H__
+#define __SMG2S_STREAM_H__
+
+#include "smg2s_direct.h"
+#include "../parMatrix/MatrixRunCSR.h"
+#include <fstream>
+#include <sstream>
+#include <complex>
+#include <string>
+
+/*Streaming generation: the local rows of each proc are generated by blocks of blockSize rows from
+  the closed form, each block is handed to a sink as a CSR block and freed just after. The matrix
+  is never held as a whole, the memory is bounded by one block, i.e. blockSize*(bandwidth of the
+  generated matrix), plus the eigenvalues of the local rows.
+
+  A sink is any object or function which can be called as sink(r0, block), where r0 is the global
+  index of the first row of the block, the row offsets of the block start from 0 and its cols are
+  global. The block belongs to the driver and should be copied if it is needed after the call*/
+
+
+template<typename T>
+void streamWriteValue(std::ofstream &file, T value){
+	file << value;
+}
+
+template<typename T>
+void streamWriteValue(std::ofstream &file, std::complex<T> value){
+	file << value.real() << " " << value.imag();
+}
+
+//field of the Matrix Market header
+template<typename T>
+const char *streamField(T){
+	return "real";
+}
+
+template<typename T>
+const char *streamField(std::complex<T>){
+	return "complex";
+}
+
+/*Sink writing the blocks in the coordinate format of Matrix Market (1-based "row col value" lines,
+  "row col real imag" for complex) into one file "prefix.rank" per proc. Each file is a Matrix
+  Market file of the size x size matrix which holds the rows of its proc: the size line is written
+  blank with a fixed width, and filled with the local nnz, only known at the end, when the sink is
+  deleted. The global nnz is returned by the stream drivers. A non empty comment is written as a
+  comment line of the header. With the prefix " ", the blocks are only counted.
+
+  With runs, each block is encoded as a MatrixRunCSR and written from it, the cols being decoded on
+  the fly, and the bytes of the indices of both formats are counted, see Report()*/
+template<typename T, typename S>
+class csrFileSink
+{
+	private:
+		std::ofstream	file;
+		bool			write;
+		bool			runs;
+
+		//global size of the matrix, and the position and width of the size line of the header
+		S				size;
+		std::streampos	sizePos;
+		static const int	sizeWidth = 64;
+
+	public:
+		//number of entries received
+		S				nnz;
+
+		//bytes of the indices of the blocks received, in MatrixCSR and in MatrixRunCSR
+		double			csrBytes, runBytes;
+
+		csrFileSink(std::string prefix, S size_in, MPI_Comm comm, bool runs_in = false, std::string comment = ""){
+			int rank;
+			MPI_Comm_rank(comm, &rank);
+
+			nnz = 0;
+			size = size_in;
+			runs = runs_in;
+			csrBytes = 0;
+			runBytes = 0;
+			write = (prefix.compare(" ") != 0);
+
+			if(write){
+				std::stringstream name;
+				name << prefix << "." << rank;
+				file.open(name.str().c_str());
+				file.precision(17);
+				if(!file.is_open()){
+					printf("ERROR ]> Cannot open the output file %s\n", name.str().c_str());
+					write = false;
+				}
+			}
+
+			if(write){
+				file << "%%MatrixMarket matrix coordinate " << streamField(T(0)) << " general\n";
+				if(!comment.empty()){
+					file << "%" << comment << "\n";
+				}
+				sizePos = file.tellp();
+				file << std::string(sizeWidth, ' ') << "\n";
+			}
+		};
+
+		~csrFileSink(){
+			if(file.is_open()){
+				std::stringstream line;
+				line << size << " " << size << " " << nnz;
+				file.seekp(sizePos);
+				file << line.str();
+				file.close();
+			}
+		};
+
+		void operator()(S r0, MatrixCSR<T,S> *block){
+			if(runs){
+				MatrixRunCSR<T,S> rblock(block);
+				(*this)(r0, &rblock);
+				return;
+			}
+			if(write){
+				for(S i = 0; i < block->nrows; i++){
+					for(S k = block->rows[i]; k < block->rows[i + 1]; k++){
+						file << r0 + i + 1 << " " << block->cols[k] + 1 << " ";
+						streamWriteValue(file, block->vals[k]);
+						file << "\n";
+					}
+				}
+			}
+			nnz = nnz + block->nnz;
+		};
+
+		void operator()(S r0, MatrixRunCSR<T,S> *block){
+			if(write){
+				S k = 0;
+				for(S i = 0; i < block->nrows; i++){
+					for(S r = block->runptr[i]; r < block->runptr[i + 1]; r++){
+						for(S c = block->runcol[r]; c < block->runcol[r] + S(block->runlen[r]); c++){
+							file << r0 + i + 1 << " " << c + 1 << " ";
+							streamWriteValue(file, block->vals[k]);
+							file << "\n";
+							k++;
+						}
+					}
+				}
+			}
+			nnz = nnz + block->nnz;
+			csrBytes = csrBytes + block->CSRIndexBytes();
+			runBytes = runBytes + block->IndexBytes();
+		};
+
+		//bytes of the indices of all the blocks in both formats, reported by the proc 0 of comm when runs is set
+		void Report(MPI_Comm comm){
+			double	loc[2] = {csrBytes, runBytes}, glob[2];
+			int		rank;
+
+			if(!runs){
+				return;
+			}
+
+			MPI_Comm_rank(comm, &rank);
+			MPI_Reduce(loc, glob, 2, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+			if(rank == 0 && glob[0] > 0){
+				printf("Column indices stored as runs: %1.0f bytes in place of %1.0f in CSR (%1.1f%%)\n", glob[1], glob[0], 100.0*glob[1]/glob[0]);
+			}
+		};
+};
+
+
+//generate the rows [lower_b, upper_b) by blocks of blockSize rows and hand them to the sink, returns the local nnz
+template<typename T, typename S, class Init, class Sink>
+S directStream(Nilpotency<S> nilp, S probSize, Init &A0, S lower_b, S upper_b, S blockSize, Sink &sink){
+
+	directGen<T,S> gen(nilp, probSize, A0);
+
+	MatrixCSR<T,S> *block;
+
+	S r1, nnz = 0;
+
+	for(S r0 = lower_b; r0 < upper_b; r0 = r1){
+		r1 = (r0 + blockSize < upper_b) ? r0 + blockSize : upper_b;
+
+		block = directRows(gen, A0, probSize, r0, r1);
+
+		sink(r0, block);
+
+		nnz = nnz + block->nnz;
+
+		delete block;
+	}
+
+	return nnz;
+}
+
+
+//streaming version of smg2s(), returns the global nnz of the generated matrix
+template<typename T, typename S, class Sink>
+S smg2s_stream(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, S blockSize, Sink &sink, bool nnzBalance = false){
+
+	S lower_b, upper_b, spec_lb, spec_ub, nnz_loc, nnz;
+
+	if(blockSize <= 0){
+		blockSize = probSize;
+	}
+
+	rowPartition(probSize, nilp, lbandwidth, false, nnzBalance, comm, lower_b, upper_b);
+
+	spec_lb = lower_b;
+	spec_ub = upper_b + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<T,S> spec(comm, spec_lb, spec_ub);
+
+	spec.specGen(spectrum);
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, &spec);
+
+	nnz_loc = directStream<T,S>(nilp, probSize, A0, lower_b, upper_b, blockSize, sink);
+
+	reportImbalance(nnz_loc, comm);
+
+	MPI_Allreduce(&nnz_loc, &nnz, 1, MPI_Index<S>(), MPI_SUM, comm);
+
+	return nnz;
+}
+
+
+//streaming version of smg2s_nonsymmetric(), returns the global nnz of the generated matrix
+template<typename T, typename S, class Sink>
+S smg2s_nonsymmetric_stream(S probSize, Nilpotency<S> nilp, S lbandwidth, std::string spectrum, MPI_Comm comm, S blockSize, Sink &sink, bool nnzBalance = false){
+
+	S lower_b, upper_b, spec_lb, spec_ub, nnz_loc, nnz;
+
+	if(blockSize <= 0){
+		blockSize = probSize;
+	}
+
+	rowPartition(probSize, nilp, lbandwidth, true, nnzBalance, comm, lower_b, upper_b);
+
+	spec_lb = (lower_b > 0) ? lower_b - 1 : 0;
+	spec_ub = upper_b + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	parVector<std::complex<T>,S> spec(comm, spec_lb, spec_ub);
+
+	spec.specGen2(spectrum);
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, &spec);
+
+	nnz_loc = directStream<T,S>(nilp, probSize, A0, lower_b, upper_b, blockSize, sink);
+
+	reportImbalance(nnz_loc, comm);
+
+	MPI_Allreduce(&nnz_loc, &nnz, 1, MPI_Index<S>(), MPI_SUM, comm);
+
+	return nnz;
+}
+
+#endif
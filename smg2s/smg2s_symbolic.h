@@ -0,0 +1,287 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SMG2S_SYMBOLIC_H__
+#define __SMG2S_SYMBOLIC_H__
+
+#include "../parVector/parVector.h"
+#include "../parMatrix/MatrixCSR.h"
+#include "initMat.h"
+#include "directGen.h"
+#include "partition.h"
+#include <complex>
+#include <vector>
+#include <memory>
+
+/*Symbolic/numeric split of the generation, for many matrices with the same (probSize, nilp, lbandwidth)
+  and different spectra.
+
+  The generated matrix is linear in the initial matrix, whose entries are either fixed (the band) or
+  depend on one eigenvalue (the diagonal and the 2x2 blocks). The symbolic phase builds once the local
+  CSR pattern, the fixed part of each nnz and the list of (eigenvalue, part, coefficient) terms it gets
+  from the closed form of smg2s_direct.h. The numeric phase only computes
+
+		vals[k] = base[k] + sum_t coef[t] * part(eigenvalue[t])
+
+  into the preallocated CSR, in one sweep over these arrays. The pattern keeps the entries which only
+  vanish for some spectra, e.g. the 2x2 blocks of the real eigenvalues in the non symmetric case, and
+  the ones whose terms cancel, as their value is flushed to 0 instead of being left with a roundoff
+  residue (see directGen.h)*/
+template<typename T, typename S>
+class smg2sPattern
+{
+	private:
+		S	probSize, lbandwidth;
+		bool	nonsym;
+
+		MPI_Comm	comm;
+
+		//local rows, and the eigenvalues needed to fill them
+		S	lower_b, upper_b;
+		S	spec_lb, spec_ub;
+
+		//part of each nnz which does not depend on the spectrum
+		std::vector<T>		base;
+
+		//the terms of the nnz k are [tptr[k], tptr[k+1])
+		std::vector<S>		tptr;
+		std::vector<S>		tidx;
+		std::vector<char>	tkind;
+		std::vector<T>		tcoef;
+
+		//exact nnz of the local rows
+		S	nnz_loc;
+
+		//relative tolerance of the residues, see directGen::Tol()
+		double	tol;
+
+		template<class Init>
+		void	Fill(Init &A0);
+
+		bool	CheckSpec(S lb, S ub);
+
+	public:
+		//local rows of the generated matrix, the row offsets start from 0 and the cols are global
+		std::unique_ptr<MatrixCSR<T,S> >	CSR_loc;
+
+		//partition of the rows and allocation of the pattern, see smg2s_pattern() and smg2s_nonsymmetric_pattern()
+		smg2sPattern(S size, Nilpotency<S> nilp, S lband, bool nonsym_in, MPI_Comm ncomm, bool nnzBalance = false);
+
+		//symbolic phase, A0 gives the pattern of the initial matrix
+		template<class Init>
+		void	Symbolic(Nilpotency<S> nilp, Init &A0);
+
+		//move only: the CSR goes with the pattern
+		smg2sPattern(smg2sPattern<T,S> &&P) = default;
+		smg2sPattern<T,S> &operator=(smg2sPattern<T,S> &&P) = default;
+		smg2sPattern(const smg2sPattern<T,S> &) = delete;
+		smg2sPattern<T,S> &operator=(const smg2sPattern<T,S> &) = delete;
+
+		S	GetLowerBound(){return lower_b;};
+		S	GetUpperBound(){return upper_b;};
+		S	GetSpecLower(){return spec_lb;};
+		S	GetSpecUpper(){return spec_ub;};
+		S	GetNnzTerms(){return tidx.size();};
+
+		//new vector with the eigenvalues window of this proc, to be given by specGen() or specGen2()
+		parVector<T,S>	*NewSpec();
+		parVector<std::complex<T>,S>	*NewSpec2();
+
+		//numeric phase, non Hermitian and non symmetric cases
+		void	Numeric(parVector<T,S> *spec);
+		void	Numeric2(parVector<std::complex<T>,S> *spec);
+};
+
+
+template<typename T, typename S>
+smg2sPattern<T,S>::smg2sPattern(S size, Nilpotency<S> nilp, S lband, bool nonsym_in, MPI_Comm ncomm, bool nnzBalance)
+{
+	probSize = size;
+	lbandwidth = lband;
+	nonsym = nonsym_in;
+	comm = ncomm;
+
+	//the nnz model gives the partition and the exact size of the pattern
+	rowNnzModel<S> model(probSize, nilp, lbandwidth, nonsym);
+
+	rowPartition(model, probSize, nnzBalance, comm, lower_b, upper_b);
+
+	spec_lb = (nonsym && lower_b > 0) ? lower_b - 1 : lower_b;
+	spec_ub = upper_b + 2*nilp.nbOne*(nilp.diagPosition - 1);
+	if(spec_ub > probSize){
+		spec_ub = probSize;
+	}
+
+	nnz_loc = S(model.Prefix(upper_b) - model.Prefix(lower_b));
+	tol = 0.0;
+
+	CSR_loc.reset(new MatrixCSR<T,S>(nnz_loc, upper_b - lower_b));
+	CSR_loc->ncols = probSize;
+}
+
+template<typename T, typename S>
+template<class Init>
+void smg2sPattern<T,S>::Symbolic(Nilpotency<S> nilp, Init &A0)
+{
+	directGen<T,S> gen(nilp, probSize, A0);
+
+	tol = gen.Tol();
+
+	S *cols = new S[gen.MaxRowSize()];
+	T *vals = new T[gen.MaxRowSize()];
+	S *nterm = new S[gen.MaxRowSize()];
+
+	S cnt, count = 0;
+
+	base.reserve(nnz_loc);
+	tptr.reserve(nnz_loc + 1);
+
+	tptr.push_back(0);
+
+	for(S i = lower_b; i < upper_b; i++){
+		CSR_loc->rows.push_back(count);
+		cnt = gen.SymRow(i, A0, cols, vals, nterm, tidx, tkind, tcoef);
+		for(S k = 0; k < cnt; k++){
+			CSR_loc->cols.push_back(cols[k]);
+			base.push_back(vals[k]);
+			tptr.push_back(tptr.back() + nterm[k]);
+			count++;
+		}
+	}
+	CSR_loc->rows.push_back(count);
+
+	CSR_loc->nnz = count;
+	CSR_loc->vals.resize(count);
+
+	delete [] cols;
+	delete [] vals;
+	delete [] nterm;
+}
+
+template<typename T, typename S>
+template<class Init>
+void smg2sPattern<T,S>::Fill(Init &A0)
+{
+	S	nnz = CSR_loc->nnz;
+	T	v, term;
+	double	mag;
+
+	for(S k = 0; k < nnz; k++){
+		v = base[k];
+		mag = std::abs(base[k]);
+		for(S t = tptr[k]; t < tptr[k + 1]; t++){
+			term = tcoef[t] * A0.Eval(tidx[t], tkind[t]);
+			v = v + term;
+			mag += std::abs(term);
+		}
+		CSR_loc->vals[k] = (std::abs(v) > tol*mag) ? v : T(0);
+	}
+}
+
+template<typename T, typename S>
+bool smg2sPattern<T,S>::CheckSpec(S lb, S ub)
+{
+	if(lb > spec_lb || ub < spec_ub){
+		printf("ERROR ]> The spectrum window [%ld, %ld) does not cover the eigenvalues [%ld, %ld) of the local rows\n", (long)lb, (long)ub, (long)spec_lb, (long)spec_ub);
+		return false;
+	}
+	return true;
+}
+
+template<typename T, typename S>
+parVector<T,S> *smg2sPattern<T,S>::NewSpec()
+{
+	return new parVector<T,S>(comm, spec_lb, spec_ub);
+}
+
+template<typename T, typename S>
+parVector<std::complex<T>,S> *smg2sPattern<T,S>::NewSpec2()
+{
+	return new parVector<std::complex<T>,S>(comm, spec_lb, spec_ub);
+}
+
+template<typename T, typename S>
+void smg2sPattern<T,S>::Numeric(parVector<T,S> *spec)
+{
+	if(nonsym){
+		printf("ERROR ]> Numeric() is for the non Hermitian pattern, use Numeric2()\n");
+		return;
+	}
+
+	if(!CheckSpec(spec->GetLowerBound(), spec->GetUpperBound())){
+		return;
+	}
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, spec);
+
+	Fill(A0);
+}
+
+template<typename T, typename S>
+void smg2sPattern<T,S>::Numeric2(parVector<std::complex<T>,S> *spec)
+{
+	if(!nonsym){
+		printf("ERROR ]> Numeric2() is for the non symmetric pattern, use Numeric()\n");
+		return;
+	}
+
+	if(!CheckSpec(spec->GetLowerBound(), spec->GetUpperBound())){
+		return;
+	}
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, spec);
+
+	Fill(A0);
+}
+
+
+//symbolic phase of smg2s(): pattern of the non Hermitian matrices given by (probSize, nilp, lbandwidth)
+template<typename T, typename S>
+smg2sPattern<T,S> *smg2s_pattern(S probSize, Nilpotency<S> nilp, S lbandwidth, MPI_Comm comm, bool nnzBalance = false){
+
+	smg2sPattern<T,S> *pattern = new smg2sPattern<T,S>(probSize, nilp, lbandwidth, false, comm, nnzBalance);
+
+	initMatNonHerm<T,S> A0(probSize, lbandwidth, NULL);
+
+	pattern->Symbolic(nilp, A0);
+
+	return pattern;
+}
+
+
+//symbolic phase of smg2s_nonsymmetric()
+template<typename T, typename S>
+smg2sPattern<T,S> *smg2s_nonsymmetric_pattern(S probSize, Nilpotency<S> nilp, S lbandwidth, MPI_Comm comm, bool nnzBalance = false){
+
+	smg2sPattern<T,S> *pattern = new smg2sPattern<T,S>(probSize, nilp, lbandwidth, true, comm, nnzBalance);
+
+	initMatNonSym<T,S> A0(probSize, lbandwidth, NULL);
+
+	pattern->Symbolic(nilp, A0);
+
+	return pattern;
+}
+
+#endif
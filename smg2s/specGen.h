@@ -29,21 +29,22 @@ SOFTWARE.
 #include "../parMatrix/parMatrixSparse.h"
 #include "complex"
 #include "../utils/utils.h"
+#include "initMat.h"
 #include <string>
 
 template<>
 void parVector<std::complex<double>,int>::specGen(std::string spectrum){
 
-  int    size;
-  size = GetGlobalSize();
+  int    upper;
+  upper = GetUpperBound();
   std::complex<double>    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i++){
+      for(int i=GetLowerBound(); i < upper; i++){
         val.real(i*10+1);
         val.imag(i*10+1);
         SetValueGlobal(i, val);
@@ -59,16 +60,16 @@ void parVector<std::complex<double>,int>::specGen(std::string spectrum){
 template<>
 void parVector<std::complex<double>,__int64_t>::specGen(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   std::complex<double>    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(__int64_t i=0; i < size; i++){
+      for(__int64_t i=GetLowerBound(); i < upper; i++){
         val.real(i*10+1);
         val.imag(i*10+1);
         SetValueGlobal(i, val);
@@ -84,16 +85,16 @@ void parVector<std::complex<double>,__int64_t>::specGen(std::string spectrum){
 template<>
 void parVector<double,int>::specGen(std::string spectrum){
 
-	int    size;
-	size = GetGlobalSize();
+	int    upper;
+	upper = GetUpperBound();
 	double    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i++){
+      for(int i=GetLowerBound(); i < upper; i++){
         val = i*10+1;
         SetValueGlobal(i, val);
       }
@@ -107,16 +108,16 @@ void parVector<double,int>::specGen(std::string spectrum){
 template<>
 void parVector<double,__int64_t>::specGen(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   double    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(__int64_t i=0; i < size; i++){
+      for(__int64_t i=GetLowerBound(); i < upper; i++){
         val = i*10+1;
         SetValueGlobal(i, val);
       }
@@ -130,16 +131,16 @@ void parVector<double,__int64_t>::specGen(std::string spectrum){
 template<>
 void parVector<float,int>::specGen(std::string spectrum){
 
-  int    size;
-  size = GetGlobalSize();
+  int    upper;
+  upper = GetUpperBound();
   float    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i++){
+      for(int i=GetLowerBound(); i < upper; i++){
         val = i*10+1;
         SetValueGlobal(i, val);
       }
@@ -153,16 +154,16 @@ void parVector<float,int>::specGen(std::string spectrum){
 template<>
 void parVector<float,__int64_t>::specGen(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   float    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(__int64_t i=0; i < size; i++){
+      for(__int64_t i=GetLowerBound(); i < upper; i++){
         val = i*10+1;
         SetValueGlobal(i, val);
       }
@@ -176,16 +177,16 @@ void parVector<float,__int64_t>::specGen(std::string spectrum){
 template<>
 void parVector<std::complex<float>,int>::specGen(std::string spectrum){
 
-  int    size;
-  size = GetGlobalSize();
+  int    upper;
+  upper = GetUpperBound();
   std::complex<float>    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i++){
+      for(int i=GetLowerBound(); i < upper; i++){
         val.real(i*10+1);
         val.imag(i*10+1);
         SetValueGlobal(i, val);
@@ -201,16 +202,16 @@ void parVector<std::complex<float>,int>::specGen(std::string spectrum){
 template<>
 void parVector<std::complex<float>,__int64_t>::specGen(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   std::complex<float>    val;
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(__int64_t i=0; i < size; i++){
+      for(__int64_t i=GetLowerBound(); i < upper; i++){
         val.real(i*10+1);
         val.imag(i*10+1);
         SetValueGlobal(i, val);
@@ -223,8 +224,8 @@ void parVector<std::complex<float>,__int64_t>::specGen(std::string spectrum){
 
 
 
-template<typename T, typename S>
-void matInit(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize, S lbandwidth){
+template<typename T, typename S, typename R>
+void matInit(parMatrixSparse<T,S,R> *Am, parMatrixSparse<T,S,R> *matAop, S probSize, S lbandwidth){
 
     T rnd;
 
@@ -244,8 +245,7 @@ void matInit(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize,
     for(S i = 0; i < probSize; i++){
         for(S j = i - lbandwidth; j < i; j++){
             if(j >= 0){
-              //rnd = scale * random<T,S>(0,10);
-              rnd = 1;
+              rnd = bandSetting().Value(i, j);
               Am->Loc_SetValue(i,j,rnd);
               matAop->Loc_SetValue(i,j,rnd);
             }
@@ -253,4 +253,33 @@ void matInit(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize,
     }
 }
 
+
+/*Rank-local version of matInit: each rank only visits its own rows [lower_b, upper_b)
+  and inserts the lower band together with the diagonal of a row in one go*/
+
+template<typename T, typename S, typename R>
+void matInitLoc(parMatrixSparse<T,S,R> *Am, parMatrixSparse<T,S,R> *matAop, S probSize, S lbandwidth, parVector<T,S> *diag){
+
+    S lower_b = Am->GetYLowerBound();
+    S upper_b = Am->GetYUpperBound();
+
+    initMatNonHerm<T,S> A0(probSize, lbandwidth, diag);
+
+    S *cols = new S[A0.MaxRowSize()];
+    T *vals = new T[A0.MaxRowSize()];
+
+    S cnt, loc_row;
+
+    for(S i = lower_b; i < upper_b && i < probSize; i++){
+        loc_row = i - lower_b;
+        cnt = A0.Row(i, cols, vals);
+
+        Am->Loc_SetRowLocal(loc_row, cnt, cols, vals);
+        matAop->Loc_SetRowLocal(loc_row, cnt, cols, vals);
+    }
+
+    delete [] cols;
+    delete [] vals;
+}
+
 #endif
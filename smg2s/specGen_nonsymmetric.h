@@ -29,6 +29,7 @@ SOFTWARE.
 #include "../parMatrix/parMatrixSparse.h"
 #include "complex"
 #include "../utils/utils.h"
+#include "initMat.h"
 #include <string>
 
 /*Non symmetric case*/
@@ -36,18 +37,18 @@ SOFTWARE.
 template<>
 void parVector<std::complex<double>,int>::specGen2(std::string spectrum){
 
-  int    size;
-  size = GetGlobalSize();
+  int    upper;
+  upper = GetUpperBound();
   std::complex<double>    val;
   std::complex<double>    val2;
 
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i=i+2){
+      for(int i=GetLowerBound()-GetLowerBound()%2; i < upper; i=i+2){
         if( i == 2 ){
             val.real(i*1+3);
             val.imag(0);
@@ -72,18 +73,18 @@ void parVector<std::complex<double>,int>::specGen2(std::string spectrum){
 template<>
 void parVector<std::complex<float>,int>::specGen2(std::string spectrum){
 
-  int    size;
-  size = GetGlobalSize();
+  int    upper;
+  upper = GetUpperBound();
   std::complex<float>    val;
   std::complex<float>    val2;
 
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i=i+2){
+      for(int i=GetLowerBound()-GetLowerBound()%2; i < upper; i=i+2){
         if( i == 2 ){
             val.real(i*1+3);
             val.imag(0);
@@ -108,18 +109,18 @@ void parVector<std::complex<float>,int>::specGen2(std::string spectrum){
 template<>
 void parVector<std::complex<double>,__int64_t>::specGen2(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   std::complex<double>    val;
   std::complex<double>    val2;
 
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(__int64_t i=0; i < size; i = i + 2){
+      for(__int64_t i=GetLowerBound()-GetLowerBound()%2; i < upper; i = i + 2){
         if( i == 2 ){
             val.real(i*1+3);
             val.imag(0);
@@ -144,18 +145,18 @@ void parVector<std::complex<double>,__int64_t>::specGen2(std::string spectrum){
 template<>
 void parVector<std::complex<float>,__int64_t>::specGen2(std::string spectrum){
 
-  __int64_t    size;
-  size = GetGlobalSize();
+  __int64_t    upper;
+  upper = GetUpperBound();
   std::complex<float>    val;
   std::complex<float>    val2;
 
 
    if (spectrum.compare(" ") == 0){
-      if(GetVecMap()->GetRank() == 0){
+      if(specGenInfo()){
          printf("Info ]> Do not provide the outside given spectrum file, using the internel function to generate them.\n");
       }
 
-      for(int i=0; i < size; i=i+2){
+      for(__int64_t i=GetLowerBound()-GetLowerBound()%2; i < upper; i=i+2){
         if( i == 2 ){
             val.real(i*1+3);
             val.imag(0);
@@ -178,8 +179,8 @@ void parVector<std::complex<float>,__int64_t>::specGen2(std::string spectrum){
 }
 
 
-template<typename T, typename S>
-void matInit2(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize, S lbandwidth, parVector<std::complex<T>,S> *spec){
+template<typename T, typename S, typename R>
+void matInit2(parMatrixSparse<T,S,R> *Am, parMatrixSparse<T,S,R> *matAop, S probSize, S lbandwidth, parVector<std::complex<T>,S> *spec){
 
     T rnd;
     std::complex<T> *array;
@@ -204,8 +205,7 @@ void matInit2(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize
     for(S i = 0; i < probSize; i++){
         for(S j = i - lbandwidth; j < i - 1; j++){
             if(j >= 0){
-              //rnd = scale * random<T,S>(0,10);
-              rnd = 0.01;
+              rnd = 0.01 * bandSetting().Value(i, j);
               Am->Loc_SetValue(i,j,rnd);
               matAop->Loc_SetValue(i,j,rnd);
             }
@@ -236,4 +236,56 @@ void matInit2(parMatrixSparse<T,S> *Am, parMatrixSparse<T,S> *matAop, S probSize
     
 }
 
+
+/*Rank-local version of matInit2: each rank only visits its own rows [lower_b, upper_b).
+  The 2x2 block of a conjugate pair (i, i+1) can straddle two ranks, so the last
+  eigenvalue of the previous rank is received before the rows are inserted*/
+
+template<typename T, typename S, typename R>
+void matInit2Loc(parMatrixSparse<T,S,R> *Am, parMatrixSparse<T,S,R> *matAop, S probSize, S lbandwidth, parVector<std::complex<T>,S> *spec){
+
+    std::complex<T> *array;
+    std::complex<T> prev = 0;
+
+    array = spec->GetArray();
+
+    S lower_b = Am->GetYLowerBound();
+    S upper_b = Am->GetYUpperBound();
+    S local_size = spec->GetLocalSize();
+
+    MPI_Comm comm = spec->GetVecMap()->GetCurrentComm();
+    int rank, nprocs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nprocs);
+
+    int up = (rank == 0) ? MPI_PROC_NULL : rank - 1;
+    int down = (rank == nprocs - 1) ? MPI_PROC_NULL : rank + 1;
+
+    MPI_Datatype MPI_SCALAR = MPI_Scalar<std::complex<T> >();
+
+    std::complex<T> last = (local_size > 0) ? array[local_size - 1] : std::complex<T>(0);
+
+    MPI_Sendrecv(&last, 1, MPI_SCALAR, down, 0, &prev, 1, MPI_SCALAR, up, 0, comm, MPI_STATUS_IGNORE);
+
+    MPI_Type_free(&MPI_SCALAR);
+
+    initMatNonSym<T,S> A0(probSize, lbandwidth, spec, prev);
+
+    S *cols = new S[A0.MaxRowSize()];
+    T *vals = new T[A0.MaxRowSize()];
+
+    S cnt, loc_row;
+
+    for(S i = lower_b; i < upper_b && i < probSize; i++){
+        loc_row = i - lower_b;
+        cnt = A0.Row(i, cols, vals);
+
+        Am->Loc_SetRowLocal(loc_row, cnt, cols, vals);
+        matAop->Loc_SetRowLocal(loc_row, cnt, cols, vals);
+    }
+
+    delete [] cols;
+    delete [] vals;
+}
+
 #endif
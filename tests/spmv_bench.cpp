@@ -1,137 +1,411 @@
 #include "../parMatrix/parMatrixSparse.h"
+#include "../smg2s/smg2s.h"
+#include "../parMatrix/MatrixRunCSR.h"
 #include <math.h>
-#include <complex.h>
 #include <string.h>
+#include <memory>
+#include <complex>
+#include <limits>
 
-#ifdef __APPLE__
-#include <sys/malloc.h>
-#else
-#include <malloc.h>
-#endif
+/*SpMV benchmark on a generated matrix, or on the matrix of a Matrix Market file given by -mat,
+  with the exchange of the ghosts given by -comm persistent (default), neighbor or datatypes.
+  With -nvec k (k > 1), the block product of k vectors, of layout given by -layout interleaved
+  (default) or col, is timed too, against k products of one vector.
 
-int main(int argc, char** argv){
+  The scalar type is given by -floattype DOUBLE (default), FLOAT, CPLX_DOUBLE or CPLX_FLOAT, and
+  the SIMD kernels of the product and of the AXPY by -simd avx512, avx2 or scalar (default: the
+  best one of the cpu), see simdKernels.h.
 
-	int printEnds = 1, printMids = 1;
+  x is set to the global index + 1 of each entry (with the half of it as imaginary part for the
+  complex types), so that the product can be checked on each proc against its CSR rows, ghosts
+  included. The vector j of the block is x + j. The AXPY y + a x is checked the same way.
 
-	int i,j,k;
+  With -format runs, the local rows are also stored as MatrixRunCSR (cols as runs, see
+  MatrixRunCSR.h), whose MatVec is timed against the same product of the CSR rows, both on a
+  window of x covering the cols of the local rows, ghosts included, filled with the values of x:
+  no exchange is timed. The product is checked as above, and ToCSR must give back the CSR rows*/
 
-	int span, lower_b, upper_b;
+//value of the scalar type from a complex, the imaginary part being dropped for the real types
+template<typename T>
+struct benchValue
+{
+	static T Make(double re, double /*im*/){return T(re);};
+	static double Eps(){return std::numeric_limits<T>::epsilon();};
+};
 
-	const int tag1 = 0, tag2 = 1;
+template<typename R>
+struct benchValue<std::complex<R> >
+{
+	static std::complex<R> Make(double re, double im){return std::complex<R>(re, im);};
+	static double Eps(){return std::numeric_limits<R>::epsilon();};
+};
 
-	int rank, size, intBuf1, intBuf2, number;
+template<typename T>
+int spmvBench(int probSize, int lbandwidth, int length, int maxCount, std::string matfile, std::string commmode, int nvec, std::string layout, std::string format){
 
-	double doubBuf1, start, finish, time;
+	int i, rank, size;
 
-	double a = 5;
+	double start, finish, time;
 
-	MPI_Status status;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+	std::unique_ptr<parMatrixSparse<T,int> > Am;
 
-	int commMethod = 0;
-	int probSize = 320000;
+	if(matfile.compare(" ") == 0){
+		Nilpotency<int> nilp;
+		nilp.NilpType1(length, probSize);
 
-	int maxCount = 500;
+		Am.reset(smg2s<T,int>(probSize, nilp, lbandwidth, " ", MPI_COMM_WORLD));
+	}else{
+		std::ifstream in(matfile.c_str());
+		std::string line;
 
-#ifndef _OPENMP
+		//size line of the file
+		while(std::getline(in, line) && (line.empty() || line[0] == '%')){
+		}
+		std::stringstream(line) >> probSize;
 
-	MPI_Init(&argc,&argv) ;
-	MPI_Comm_rank ( MPI_COMM_WORLD , &rank);
-	MPI_Comm_size ( MPI_COMM_WORLD , &size);
+		int span = int(ceil(double(probSize)/double(size)));
+		int lower_b = (rank*span < probSize) ? rank*span : probSize;
+		int upper_b = ((rank+1)*span < probSize) ? (rank+1)*span : probSize;
 
-	if(rank == 0)(std::cout << ">>>> pure MPI run \n" << std::endl);
+		parVector<T,int> v(MPI_COMM_WORLD, lower_b, upper_b);
 
-#else
-	int dummy; dummy = 0;
-	MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&dummy);
+		Am.reset(new parMatrixSparse<T,int>(&v, &v));
+		Am->ReadExtMat(matfile);
+	}
 
-	MPI_Comm_rank ( MPI_COMM_WORLD , &rank);
-        MPI_Comm_size ( MPI_COMM_WORLD , &size);
+	if(rank == 0){
+		printf ( "------------------------------------\n" );
+		printf ( "-------------  SPMV TEST -----------\n" );
+		printf ( "-------%d Procs - %d x %d matrix----\n", size, probSize, probSize );
+		printf ( "------------------------------------\n" );
+	}
 
-        if(rank == 0)(std::cout << ">>>> Hybrid MPI + OpenMP  run \n" << std::endl);
+	if(rank == 0)(std::cout << ">>>> matrix done !!! \n" << std::endl);
 
-#endif
+	Am->Loc_ConvertToCSR();
+
+	if(rank == 0)(std::cout << ">>>> matrix converted to CSR !!! \n" << std::endl);
 
-	span = int(floor(double(probSize)/double(size)));
-	
-	if (rank == size -1){
+	Am->FindColsToRecv();
 
-		lower_b = rank*span;
-		upper_b = probSize;
-	}else {
+	if(rank == 0)(std::cout << ">>>> matrix communication mapped !!! \n" << std::endl);
 
-                lower_b = rank*span;
-                upper_b = (rank+1)*span;
+	//exchange of the ghosts: persistent requests, neighborhood collective or datatypes
+	if(commmode.compare("neighbor") == 0){
+		Am->GetSpMVPlan()->SetCommMode(SPMV_NEIGHBOR);
+	}else if(commmode.compare("datatypes") == 0){
+		Am->GetSpMVPlan()->SetCommMode(SPMV_DATATYPES);
+	}else{
+		commmode = "persistent";
 	}
 
+	Am->SetupDataTypes();
 
-	if(rank == 0){
-		printf ( "------------------------------------\n" );
-		printf ( "-------------  SPMV TEST -----------\n" );
-		printf ( "-------%d Procs - %d x %d matrix----\n", size, probSize, probSize );
-		printf ( "------------------------------------\n" );
-	}	           
+	if(rank == 0)(std::cout << ">>>> matrix datatype done !!! \n" << std::endl);
+
+	std::unique_ptr<parVector<T,int> > vec(new parVector<T,int>(MPI_COMM_WORLD, Am->GetXLowerBound(), Am->GetXUpperBound()));
+	std::unique_ptr<parVector<T,int> > prod(new parVector<T,int>(MPI_COMM_WORLD, Am->GetYLowerBound(), Am->GetYUpperBound()));
+
+	T *xa = vec->GetArray();
+	for(i = 0; i < vec->GetLocalSize(); i++){
+		xa[i] = benchValue<T>::Make(double(Am->GetXLowerBound() + i + 1), 0.5*double(Am->GetXLowerBound() + i + 1));
+	}
+	prod->SetTovalue(T(0));
 
 	MPI_Barrier(MPI_COMM_WORLD);
 
-	parVector<double,int> *vec = new parVector<double,int>(MPI_COMM_WORLD, lower_b, upper_b);
-	vec->SetTovalue(a);
+	start = MPI_Wtime();
 
-	if(rank == 0)(std::cout << ">>>> xVector done !!! \n" << std::endl);
+	for (i=0;i<maxCount;i++){
+		Am->CSR_MatVecProd(vec.get(), prod.get());
+	}
 
-	parVector<double,int> *prod = new parVector<double,int>(MPI_COMM_WORLD, lower_b, upper_b);
-	prod->SetTovalue(0.0);
+	finish  = MPI_Wtime();
 
-	if(rank == 0)(std::cout << ">>>> yVector done !!! \n" << std::endl);
+	time = finish - start ;
 
-	parMatrixSparse<double,int> *Am = new parMatrixSparse<double,int>(vec,prod);	
+	//check against the local rows, x[col] = col + 1 (+ i (col + 1)/2)
+	MatrixCSR<T,int> *csr = Am->CSR_loc.get();
+	T *ya = prod->GetArray();
+	std::complex<double> ref;
+	std::vector<std::complex<double> > refs(csr->nrows);
+	double err = 0, err_max, nrm = 0, nrm_max;
+	long ghosts = Am->GetNumGhosts(), ghosts_sum;
+	long split[2] = {(long)Am->GetSpMVPlan()->GetNumInterior(), (long)Am->GetSpMVPlan()->GetNumBoundary()}, split_sum[2];
+
+	for(i = 0; i < csr->nrows; i++){
+		ref = 0;
+		for(int k = csr->rows[i]; k < csr->rows[i+1]; k++){
+			ref += std::complex<double>(csr->vals[k]) * std::complex<double>(benchValue<T>::Make(double(csr->cols[k] + 1), 0.5*double(csr->cols[k] + 1)));
+		}
+		refs[i] = ref;
+		err = std::max(err, std::abs(std::complex<double>(ya[i]) - ref));
+		nrm = std::max(nrm, std::abs(ref));
+	}
 
-	Am->ReadExtMat();
+	//AXPY y + a x, timed on another vector, on the square matrices
+	double time_axpy = 0;
+	T a = benchValue<T>::Make(0.5, -0.25);
 
-	//Am->MatView();
+	if(vec->GetLocalSize() == prod->GetLocalSize()){
+		std::unique_ptr<parVector<T,int> > w(new parVector<T,int>(vec->ShareVecMap()));
+		w->SetTovalue(T(0));
 
-        if(rank == 0)(std::cout << ">>>> matrix done !!! \n" << std::endl);
+		MPI_Barrier(MPI_COMM_WORLD);
 
-	Am->ConvertToCSR();
-	
-        if(rank == 0)(std::cout << ">>>> matrix converted to CSR !!! \n" << std::endl);
+		start = MPI_Wtime();
 
-	Am->FindColsToRecv();
-	
-        if(rank == 0)(std::cout << ">>>> matrix communication mapped !!! \n" << std::endl);
+		for(i = 0; i < maxCount; i++){
+			w->VecAXPY(a, vec.get());
+		}
 
-	Am->SetupDataTypes();
+		time_axpy = MPI_Wtime() - start;
 
-        if(rank == 0)(std::cout << ">>>> matrix datatype done !!! \n" << std::endl);
+		prod->VecAXPY(a, vec.get());
 
-        MPI_Barrier(MPI_COMM_WORLD);
+		for(i = 0; i < csr->nrows; i++){
+			ref = refs[i] + std::complex<double>(a) * std::complex<double>(xa[i]);
+			err = std::max(err, std::abs(std::complex<double>(ya[i]) - ref));
+		}
+	}
 
-	start = MPI_Wtime();
+	//block product of nvec vectors, checked the same way, the vector j being x + j
+	double time_block = 0;
+
+	if(nvec > 1){
+		multiVecLayout lay = MV_INTERLEAVED;
+		if(layout.compare("col") == 0){
+			lay = MV_COLMAJOR;
+		}else{
+			layout = "interleaved";
+		}
+
+		std::unique_ptr<parMultiVector<T,int> > X(new parMultiVector<T,int>(vec->ShareVecMap(), nvec, lay));
+		std::unique_ptr<parMultiVector<T,int> > Y(new parMultiVector<T,int>(prod->ShareVecMap(), nvec, lay));
+
+		for(i = 0; i < X->GetLocalSize(); i++){
+			for(int j = 0; j < nvec; j++){
+				X->SetValueLocal(i, j, benchValue<T>::Make(double(Am->GetXLowerBound() + i + 1 + j), 0.5*double(Am->GetXLowerBound() + i + 1)));
+			}
+		}
+		Y->SetToZero();
+
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		start = MPI_Wtime();
+
+		for(int it = 0; it < maxCount; it++){
+			Am->CSR_MatMultiVecProd(X.get(), Y.get());
+		}
+
+		time_block = MPI_Wtime() - start;
+
+		for(i = 0; i < csr->nrows; i++){
+			for(int j = 0; j < nvec; j++){
+				ref = 0;
+				for(int k = csr->rows[i]; k < csr->rows[i+1]; k++){
+					ref += std::complex<double>(csr->vals[k]) * std::complex<double>(benchValue<T>::Make(double(csr->cols[k] + 1 + j), 0.5*double(csr->cols[k] + 1)));
+				}
+				err = std::max(err, std::abs(std::complex<double>(Y->GetValueLocal(i, j)) - ref));
+				nrm = std::max(nrm, std::abs(ref));
+			}
+		}
+	}
 
-	for (i=0;i<maxCount;i++){
-		Am->CSR_MatVecProd(vec, prod);
+	//local product of the rows stored as runs, against the one of the CSR rows, on a window of x
+	double time_runs = 0, time_rows = 0;
+	long nruns[2] = {0, 0}, nruns_sum[2];
+	int mismatch = 0, mismatch_max;
+
+	if(format.compare("runs") == 0){
+		MatrixRunCSR<T,int> rcsr(csr);
+
+		int xlo = 0, xhi = -1;
+		for(int k = 0; k < csr->nnz; k++){
+			if(xhi < xlo){
+				xlo = csr->cols[k];
+				xhi = csr->cols[k];
+			}
+			xlo = std::min(xlo, csr->cols[k]);
+			xhi = std::max(xhi, csr->cols[k]);
+		}
+
+		std::vector<T> xw(xhi - xlo + 1), yr(csr->nrows), yc(csr->nrows);
+		for(int c = xlo; c <= xhi; c++){
+			xw[c - xlo] = benchValue<T>::Make(double(c + 1), 0.5*double(c + 1));
+		}
+
+		MPI_Barrier(MPI_COMM_WORLD);
+
+		start = MPI_Wtime();
+
+		for(int it = 0; it < maxCount; it++){
+			rcsr.MatVec(xw.data(), xlo, yr.data());
+		}
+
+		time_runs = MPI_Wtime() - start;
+
+		start = MPI_Wtime();
+
+		for(int it = 0; it < maxCount; it++){
+			for(i = 0; i < csr->nrows; i++){
+				T sum = T(0);
+				for(int k = csr->rows[i]; k < csr->rows[i+1]; k++){
+					sum += csr->vals[k] * xw[csr->cols[k] - xlo];
+				}
+				yc[i] = sum;
+			}
+		}
+
+		time_rows = MPI_Wtime() - start;
+
+		for(i = 0; i < csr->nrows; i++){
+			err = std::max(err, std::abs(std::complex<double>(yr[i]) - refs[i]));
+		}
+
+		std::unique_ptr<MatrixCSR<T,int> > back(rcsr.ToCSR());
+		mismatch = (back->nnz != csr->nnz || back->rows != csr->rows || back->cols != csr->cols || back->vals != csr->vals);
+
+		nruns[0] = rcsr.GetNumRuns();
+		nruns[1] = csr->nnz;
 	}
 
-	finish  = MPI_Wtime();
+	MPI_Reduce(&mismatch, &mismatch_max, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Reduce(nruns, nruns_sum, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
 
-	time = finish - start ;
+	MPI_Reduce(&err, &err_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&nrm, &nrm_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&ghosts, &ghosts_sum, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(split, split_sum, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+	int fail = 0;
 
 	if(rank == 0){
 		printf ( "------------------------------------\n" );
-                printf ( "---- SPMV Time is %f seconds --------\n", time );
-                printf ( "------------------------------------\n" );
+		printf ( "---- SPMV Time is %f seconds --------\n", time );
+		printf ( "---- exchange of the ghosts: %s, SIMD kernels: %s\n", commmode.c_str(), simdLevelName(simdGetLevel()) );
+		printf ( "---- %d products, %ld ghosts received per product\n", maxCount, ghosts_sum );
+		printf ( "---- %ld interior rows computed during the exchange, %ld boundary rows after\n", split_sum[0], split_sum[1] );
+		printf ( "---- %d AXPY: %f seconds\n", maxCount, time_axpy );
+		if(nvec > 1){
+			printf ( "---- block product of %d vectors (%s): %f seconds, %f seconds for %d products of one vector\n", nvec, layout.c_str(), time_block, nvec*time, nvec );
+		}
+		if(format.compare("runs") == 0){
+			printf ( "---- %d local products of the rows as runs (%ld runs for %ld nnz): %f seconds, %f seconds for the CSR rows\n", maxCount, nruns_sum[0], nruns_sum[1], time_runs, time_rows );
+			printf ( "---- ToCSR of the runs %s the CSR rows\n", mismatch_max ? "differs from" : "gives back" );
+		}
+		printf ( "---- max error %e (max |y| %e)\n", err_max, nrm_max );
+		printf ( "------------------------------------\n" );
+		//the sums are done in another order by the SIMD kernels
+		fail = (err_max > 1e3*benchValue<T>::Eps()*nrm_max) || mismatch_max;
 	}
 
+	MPI_Bcast(&fail, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
 	MPI_Barrier(MPI_COMM_WORLD);
 
-/*
-	delete Am;
-	delete vec;
-	delete prod;
-*/
+	return fail;
+}
+
+int main(int argc, char** argv){
+
+	int i;
+
+	int rank, size;
+
+	int probSize = 320000, lbandwidth = 10, length = 4;
+
+	int maxCount = 500;
+
+	std::string matfile = " ";
+
+	std::string commmode = "persistent";
+
+	int nvec = 1;
+
+	std::string layout = "interleaved";
+
+	std::string floattype = "DOUBLE";
+
+	std::string simd = " ";
+
+	std::string format = "csr";
+
+#ifndef _OPENMP
+
+	MPI_Init(&argc,&argv) ;
+	MPI_Comm_rank ( MPI_COMM_WORLD , &rank);
+	MPI_Comm_size ( MPI_COMM_WORLD , &size);
+
+	if(rank == 0)(std::cout << ">>>> pure MPI run \n" << std::endl);
+
+#else
+	int dummy; dummy = 0;
+	MPI_Init_thread(&argc,&argv,MPI_THREAD_FUNNELED,&dummy);
+
+	MPI_Comm_rank ( MPI_COMM_WORLD , &rank);
+	MPI_Comm_size ( MPI_COMM_WORLD , &size);
+
+	if(rank == 0)(std::cout << ">>>> Hybrid MPI + OpenMP  run \n" << std::endl);
+
+#endif
+
+	for (i = 0; i < argc - 1; i++){
+		if (strcasecmp(argv[i],"-SIZE")==0){
+			probSize = atoi(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-L")==0){
+			lbandwidth = atoi(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-C")==0){
+			length = atoi(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-iter")==0){
+			maxCount = atoi(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-mat")==0){
+			matfile.assign(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-comm")==0){
+			commmode.assign(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-nvec")==0){
+			nvec = atoi(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-layout")==0){
+			layout.assign(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-floattype")==0){
+			floattype.assign(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-simd")==0){
+			simd.assign(argv[i+1]);
+		}
+		if (strcasecmp(argv[i],"-format")==0){
+			format.assign(argv[i+1]);
+		}
+	}
+
+	if(simd.compare(" ") != 0 && !simdSetLevel(simd) && rank == 0){
+		printf("ERROR ]> Unknown SIMD kernels %s, the ones of the cpu are used\n", simd.c_str());
+	}
+
+	int fail;
+
+	if(floattype.compare("FLOAT") == 0){
+		fail = spmvBench<float>(probSize, lbandwidth, length, maxCount, matfile, commmode, nvec, layout, format);
+	}else if(floattype.compare("CPLX_DOUBLE") == 0){
+		fail = spmvBench<std::complex<double> >(probSize, lbandwidth, length, maxCount, matfile, commmode, nvec, layout, format);
+	}else if(floattype.compare("CPLX_FLOAT") == 0){
+		fail = spmvBench<std::complex<float> >(probSize, lbandwidth, length, maxCount, matfile, commmode, nvec, layout, format);
+	}else{
+		fail = spmvBench<double>(probSize, lbandwidth, length, maxCount, matfile, commmode, nvec, layout, format);
+	}
 
 	MPI_Finalize();
 
-	return 0;
+	return fail;
 }
-
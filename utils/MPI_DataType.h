@@ -59,4 +59,16 @@ MPI_Datatype MPI_Scalar(){
 }; 
 
 
+template<class S>
+MPI_Datatype MPI_Index(){
+
+	if(sizeof(S) == sizeof(long long)){
+		return MPI_LONG_LONG;
+	} else {
+		return MPI_INT;
+	}
+
+};
+
+
 #endif
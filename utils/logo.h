@@ -83,7 +83,23 @@ static void show_usage(std::string name)
 {
     std::cerr << "Usage: mpirun -np ${PROCS} " << name << " -SIZE ${MATRIX SIZE} -L ${LOWER BANDWIDTH} -C ${NB ONES FOR NILPOTENT MATRIX}\n"
               << "Options:\n"
-              << "\t-h,--help\t\tShow this HELP message\n\n"
+              << "\t-h,--help\t\tShow this HELP message\n"
+              << "\t-genmode direct\t\tAssemble the rows from the closed form instead of the 2*C iterations\n"
+              << "\t-genmode symbolic\tBuild the pattern of the matrix first, then fill the values for the spectrum\n"
+              << "\t-stream ${BLOCK}\t\tGenerate and hand out the rows by blocks of ${BLOCK} rows, without holding the matrix\n"
+              << "\t-outfile ${PREFIX}\tWrite the streamed blocks into the files ${PREFIX}.${RANK}\n"
+              << "\t-partition nnz\t\tSplit the rows among the procs with the same number of nonzeros\n"
+              << "\t-ensemble ${JOBFILE}\tGenerate the matrices of ${JOBFILE}, lines \"SIZE L C [DIAGP [SPECTRUM]]\"\n"
+              << "\t-groupsize ${G}\t\tNumber of procs of the groups sharing the ensemble jobs\n"
+              << "\t-storage flat\t\tStore the rows as sorted arrays instead of std::map (iterative and direct modes)\n"
+              << "\t-storage pool\t\tTake the nodes of the std::map rows from a memory pool of the matrix\n"
+              << "\t-storage dia\t\tGenerate and store the matrix by diagonals (DIA)\n"
+              << "\t-acctype DOUBLE\t\tGenerate FLOAT and CPLX_FLOAT matrices in double, round to float at the CSR output\n"
+              << "\t-csrformat runs\t\tEncode the written CSR blocks with the cols of each row as runs\n"
+              << "\t-timeinit global\tTime the former global row sweep of the initial matrix too, for the measured speedup\n"
+              << "\t-band ${DIST}\t\tDistribution of the lower band: const (default), uniform or normal\n"
+              << "\t-banda ${A} -bandb ${B}\tConstant A, uniform on [A, B), or normal of mean A and deviation B\n"
+              << "\t-seed ${SEED}\t\tSeed of the band values, the same for any number of procs\n\n"
               << std::endl;
 }
 
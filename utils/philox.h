@@ -0,0 +1,143 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __PHILOX_H__
+#define __PHILOX_H__
+
+#include <stdint.h>
+#include <string>
+#include <math.h>
+
+/*Counter-based random numbers: Philox4x32-10 of Salmon et al., "Parallel random numbers: as easy
+  as 1, 2, 3" (SC11). The output is a pure function of (key, counter), there is no state to share
+  or to advance, so any proc or thread gets the same value for the same counter without
+  communication, whatever the decomposition*/
+
+//one Philox4x32-10 block: ctr is replaced by the 4 random words of (key, ctr)
+inline void philox4x32(uint32_t ctr[4], uint32_t key[2]){
+
+	const uint32_t	M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	const uint32_t	W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+	uint32_t	k0 = key[0], k1 = key[1];
+	uint64_t	p0, p1;
+
+	for(int round = 0; round < 10; round++){
+		p0 = uint64_t(M0) * ctr[0];
+		p1 = uint64_t(M1) * ctr[2];
+
+		ctr[0] = uint32_t(p1 >> 32) ^ ctr[1] ^ k0;
+		ctr[1] = uint32_t(p1);
+		ctr[2] = uint32_t(p0 >> 32) ^ ctr[3] ^ k1;
+		ctr[3] = uint32_t(p0);
+
+		k0 = k0 + W0;
+		k1 = k1 + W1;
+	}
+}
+
+//uniform double in [0, 1) from two random words, with 53 random bits
+inline double philoxUniform(uint32_t hi, uint32_t lo){
+	return (double(hi >> 5) * 67108864.0 + double(lo >> 6)) * (1.0/9007199254740992.0);
+}
+
+
+//distributions of the values of the lower band of the initial matrix
+enum bandDist {BAND_CONST, BAND_UNIFORM, BAND_NORMAL};
+
+/*Value of the entry (row, col) of the lower band: a for BAND_CONST, uniform on [a, b) for
+  BAND_UNIFORM, normal of mean a and deviation b for BAND_NORMAL, keyed by (seed, row, col)*/
+struct bandRandom
+{
+	int			dist;
+	double		a, b;
+	uint64_t	seed;
+
+	bandRandom(){
+		dist = BAND_CONST;
+		a = 1.0;
+		b = 0.0;
+		seed = 0;
+	};
+
+	double Value(int64_t row, int64_t col){
+
+		if(dist == BAND_CONST){
+			return a;
+		}
+
+		uint32_t key[2] = {uint32_t(seed), uint32_t(seed >> 32)};
+		uint32_t ctr[4] = {uint32_t(uint64_t(row)), uint32_t(uint64_t(row) >> 32), uint32_t(uint64_t(col)), uint32_t(uint64_t(col) >> 32)};
+
+		philox4x32(ctr, key);
+
+		double u1 = philoxUniform(ctr[0], ctr[1]);
+
+		if(dist == BAND_UNIFORM){
+			return a + (b - a) * u1;
+		}
+
+		//Box-Muller, 1 - u1 lies in (0, 1]
+		double u2 = philoxUniform(ctr[2], ctr[3]);
+
+		return a + b * sqrt(-2.0 * log(1.0 - u1)) * cos(6.283185307179586 * u2);
+	};
+};
+
+
+//band distribution of the run, the default of the generators, see setBandRandom() and initMat.h
+inline bandRandom &bandSetting(){
+	static bandRandom band;
+	return band;
+}
+
+/*set the band distribution from its name "const", "uniform" or "normal", returns false for an
+  unknown name. The value of an entry of the band is then scale * Value(row, col), with the scale
+  of the case (1 for non Hermitian, 0.01 for non symmetric), so that the default const 1 gives the
+  former band. For a complex scalar type, Value() is the real part, the imaginary part is 0*/
+inline bool setBandRandom(std::string dist, double a, double b, uint64_t seed){
+
+	bandRandom band;
+
+	if(dist.compare("const") == 0){
+		band.dist = BAND_CONST;
+	}else if(dist.compare("uniform") == 0){
+		band.dist = BAND_UNIFORM;
+	}else if(dist.compare("normal") == 0){
+		band.dist = BAND_NORMAL;
+	}else{
+		return false;
+	}
+
+	band.a = a;
+	band.b = b;
+	band.seed = seed;
+
+	bandSetting() = band;
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,591 @@
+/*
+
+MIT License
+
+Copyright (c) 2019 Xinzhe WU
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef __SIMD_KERNELS_H__
+#define __SIMD_KERNELS_H__
+
+#include <complex>
+#include <string>
+#include <stdint.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define __SMG2S_SIMD_X86__
+#include <immintrin.h>
+#endif
+
+/*Kernels of the SpMV (rows of a CSR times x) and of the AXPY (y += a x), vectorized by hand for
+  float, double, std::complex<float> and std::complex<double>, with AVX2 + FMA and AVX-512F paths.
+
+  The path is chosen at run time from the features of the cpu (__builtin_cpu_supports), so that
+  the code is built without -mavx2 or -mavx512f and runs on any x86-64: the kernels of a path
+  are compiled for its instruction set with the target attribute only. Elsewhere, and for the
+  other scalar types, the portable kernels are used.
+
+  The compilers vectorize the products of std::complex poorly (the products are done one by one,
+  with a check for the NaN), so the complex kernels work on the real and imaginary parts, which
+  are interleaved in memory as for an array of 2 reals:
+
+	SpMV	two sums per lane, of a*x (re re, im im) and of a*swap(x) (re im, im re); the real part
+			of the row is the sum of the first one with the signs (+ -), the imaginary part the
+			sum of the second one, both reduced once at the end of the row
+	AXPY	y += fmaddsub(re(a), x, im(a)*swap(x)), i.e. a*x in two instructions
+
+  The sums of a row are done in another order than the one of the portable kernel, so that the
+  results may differ in the last bits. The cols of x are gathered with 32 or 64 bits indices,
+  after the size of the index type S*/
+
+//instruction sets of the kernels
+enum simdLevel {SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512};
+
+//best level supported by the cpu
+inline int simdDetect(){
+#ifdef __SMG2S_SIMD_X86__
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")){
+		return SIMD_AVX512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+		return SIMD_AVX2;
+	}
+#endif
+	return SIMD_SCALAR;
+}
+
+//level used by the kernels, the best one of the cpu by default
+inline int &simdSetting(){
+	static int level = simdDetect();
+	return level;
+}
+
+inline int simdGetLevel(){
+	return simdSetting();
+}
+
+inline const char *simdLevelName(int level){
+	if(level == SIMD_AVX512){
+		return "avx512";
+	}
+	if(level == SIMD_AVX2){
+		return "avx2";
+	}
+	return "scalar";
+}
+
+/*set the level from its name "scalar", "avx2" or "avx512", returns false for an unknown name. The
+  level is lowered to the best one of the cpu if needed*/
+inline bool simdSetLevel(std::string name){
+
+	int level;
+
+	if(name.compare("scalar") == 0){
+		level = SIMD_SCALAR;
+	}else if(name.compare("avx2") == 0){
+		level = SIMD_AVX2;
+	}else if(name.compare("avx512") == 0){
+		level = SIMD_AVX512;
+	}else{
+		return false;
+	}
+
+	int best = simdDetect();
+
+	simdSetting() = (level < best) ? level : best;
+
+	return true;
+}
+
+
+/*Portable kernels*/
+
+//y[i] = sum of vals[k]*x[cols[k]] on the row i, for the rows [r0, r1)
+template<typename T, typename S, typename I>
+void csrRowsScalar(const S *rows, const I *cols, const T *vals, const T *x, T *y, S r0, S r1){
+	for(S i = r0; i < r1; i++){
+		T sum = T(0);
+		for(S k = rows[i]; k < rows[i + 1]; k++){
+			sum += vals[k] * x[cols[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+template<typename R, typename S, typename I>
+void csrRowsScalar(const S *rows, const I *cols, const std::complex<R> *vals, const std::complex<R> *x, std::complex<R> *y, S r0, S r1){
+	const R *v = reinterpret_cast<const R*>(vals);
+	const R *xd = reinterpret_cast<const R*>(x);
+
+	for(S i = r0; i < r1; i++){
+		R re = 0, im = 0;
+		for(S k = rows[i]; k < rows[i + 1]; k++){
+			const R *xc = xd + 2*S(cols[k]);
+			re += v[2*k] * xc[0] - v[2*k + 1] * xc[1];
+			im += v[2*k] * xc[1] + v[2*k + 1] * xc[0];
+		}
+		y[i] = std::complex<R>(re, im);
+	}
+}
+
+//y[i] += a*x[i], i in [0, n)
+template<typename T, typename S>
+void axpyScalar(S n, T a, const T *x, T *y){
+	for(S i = 0; i < n; i++){
+		y[i] += a * x[i];
+	}
+}
+
+template<typename R, typename S>
+void axpyScalar(S n, std::complex<R> a, const std::complex<R> *x, std::complex<R> *y){
+	const R ar = a.real(), ai = a.imag();
+	const R *xd = reinterpret_cast<const R*>(x);
+	R *yd = reinterpret_cast<R*>(y);
+
+	for(S i = 0; i < n; i++){
+		R xr = xd[2*i], xi = xd[2*i + 1];
+		yd[2*i] += ar * xr - ai * xi;
+		yd[2*i + 1] += ar * xi + ai * xr;
+	}
+}
+
+
+#ifdef __SMG2S_SIMD_X86__
+
+#define __SIMD_AVX2__	__attribute__((target("avx2,fma")))
+#define __SIMD_AVX512__	__attribute__((target("avx2,fma,avx512f")))
+
+//the kernels of a path for the types without SIMD kernels are the portable ones
+template<typename T, typename S, typename I>
+void csrRowsAVX2(const S *rows, const I *cols, const T *vals, const T *x, T *y, S r0, S r1){
+	csrRowsScalar(rows, cols, vals, x, y, r0, r1);
+}
+
+template<typename T, typename S, typename I>
+void csrRowsAVX512(const S *rows, const I *cols, const T *vals, const T *x, T *y, S r0, S r1){
+	csrRowsScalar(rows, cols, vals, x, y, r0, r1);
+}
+
+template<typename T, typename S>
+void axpyAVX2(S n, T a, const T *x, T *y){
+	axpyScalar(n, a, x, y);
+}
+
+template<typename T, typename S>
+void axpyAVX512(S n, T a, const T *x, T *y){
+	axpyScalar(n, a, x, y);
+}
+
+
+/*AVX2 + FMA*/
+
+/*x at 4 (or 8) indices, in a register. The entries are loaded one by one and packed: the gather
+  instructions are slower than these loads on most cpus (much slower on the AMD ones), and the
+  cols of a row are often close, so in the cache*/
+
+//4 doubles (or 4 pairs of floats) at the indices p[0..3]
+template<typename I>
+__SIMD_AVX2__ inline __m256d gather4d(const double *x, const I *p){
+	__m128d lo = _mm_loadh_pd(_mm_load_sd(x + p[0]), x + p[1]);
+	__m128d hi = _mm_loadh_pd(_mm_load_sd(x + p[2]), x + p[3]);
+	return _mm256_set_m128d(hi, lo);
+}
+
+//8 floats at the indices p[0..7]
+template<typename I>
+__SIMD_AVX2__ inline __m256 gather8f(const float *x, const I *p){
+	__m128 lo = _mm_set_ps(x[p[3]], x[p[2]], x[p[1]], x[p[0]]);
+	__m128 hi = _mm_set_ps(x[p[7]], x[p[6]], x[p[5]], x[p[4]]);
+	return _mm256_set_m128(hi, lo);
+}
+
+__SIMD_AVX2__ inline double hsum4d(__m256d v){
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+	return _mm_cvtsd_f64(s);
+}
+
+__SIMD_AVX2__ inline float hsum8f(__m256 v){
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+template<typename S, typename I>
+__SIMD_AVX2__ void csrRowsAVX2(const S *rows, const I *cols, const double *vals, const double *x, double *y, S r0, S r1){
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m256d acc = _mm256_setzero_pd();
+		for(; k + 4 <= e; k += 4){
+			acc = _mm256_fmadd_pd(_mm256_loadu_pd(vals + k), gather4d(x, cols + k), acc);
+		}
+		double sum = hsum4d(acc);
+		for(; k < e; k++){
+			sum += vals[k] * x[cols[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX2__ void csrRowsAVX2(const S *rows, const I *cols, const float *vals, const float *x, float *y, S r0, S r1){
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m256 acc = _mm256_setzero_ps();
+		for(; k + 8 <= e; k += 8){
+			acc = _mm256_fmadd_ps(_mm256_loadu_ps(vals + k), gather8f(x, cols + k), acc);
+		}
+		float sum = hsum8f(acc);
+		for(; k < e; k++){
+			sum += vals[k] * x[cols[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX2__ void csrRowsAVX2(const S *rows, const I *cols, const std::complex<double> *vals, const std::complex<double> *x, std::complex<double> *y, S r0, S r1){
+	const double *v = reinterpret_cast<const double*>(vals);
+	const double *xd = reinterpret_cast<const double*>(x);
+	const __m256d sign = _mm256_set_pd(-1.0, 1.0, -1.0, 1.0);
+
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m256d acc = _mm256_setzero_pd(), accs = _mm256_setzero_pd();
+		for(; k + 2 <= e; k += 2){
+			__m256d va = _mm256_loadu_pd(v + 2*k);
+			__m256d xv = _mm256_set_m128d(_mm_loadu_pd(xd + 2*S(cols[k + 1])), _mm_loadu_pd(xd + 2*S(cols[k])));
+			acc = _mm256_fmadd_pd(va, xv, acc);
+			accs = _mm256_fmadd_pd(va, _mm256_permute_pd(xv, 0x5), accs);
+		}
+		double re = hsum4d(_mm256_mul_pd(acc, sign));
+		double im = hsum4d(accs);
+		for(; k < e; k++){
+			const double *xc = xd + 2*S(cols[k]);
+			re += v[2*k] * xc[0] - v[2*k + 1] * xc[1];
+			im += v[2*k] * xc[1] + v[2*k + 1] * xc[0];
+		}
+		y[i] = std::complex<double>(re, im);
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX2__ void csrRowsAVX2(const S *rows, const I *cols, const std::complex<float> *vals, const std::complex<float> *x, std::complex<float> *y, S r0, S r1){
+	const float *v = reinterpret_cast<const float*>(vals);
+	const float *xd = reinterpret_cast<const float*>(x);
+	const __m256 sign = _mm256_set_ps(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m256 acc = _mm256_setzero_ps(), accs = _mm256_setzero_ps();
+		for(; k + 4 <= e; k += 4){
+			__m256 va = _mm256_loadu_ps(v + 2*k);
+			__m256 xv = _mm256_castpd_ps(gather4d(reinterpret_cast<const double*>(x), cols + k));
+			acc = _mm256_fmadd_ps(va, xv, acc);
+			accs = _mm256_fmadd_ps(va, _mm256_permute_ps(xv, 0xB1), accs);
+		}
+		float re = hsum8f(_mm256_mul_ps(acc, sign));
+		float im = hsum8f(accs);
+		for(; k < e; k++){
+			const float *xc = xd + 2*S(cols[k]);
+			re += v[2*k] * xc[0] - v[2*k + 1] * xc[1];
+			im += v[2*k] * xc[1] + v[2*k + 1] * xc[0];
+		}
+		y[i] = std::complex<float>(re, im);
+	}
+}
+
+template<typename S>
+__SIMD_AVX2__ void axpyAVX2(S n, double a, const double *x, double *y){
+	const __m256d va = _mm256_set1_pd(a);
+	S i = 0;
+	for(; i + 4 <= n; i += 4){
+		_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX2__ void axpyAVX2(S n, float a, const float *x, float *y){
+	const __m256 va = _mm256_set1_ps(a);
+	S i = 0;
+	for(; i + 8 <= n; i += 8){
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX2__ void axpyAVX2(S n, std::complex<double> a, const std::complex<double> *x, std::complex<double> *y){
+	const __m256d ar = _mm256_set1_pd(a.real()), ai = _mm256_set1_pd(a.imag());
+	const double *xd = reinterpret_cast<const double*>(x);
+	double *yd = reinterpret_cast<double*>(y);
+	S i = 0;
+	for(; i + 2 <= n; i += 2){
+		__m256d xv = _mm256_loadu_pd(xd + 2*i);
+		__m256d ax = _mm256_fmaddsub_pd(ar, xv, _mm256_mul_pd(ai, _mm256_permute_pd(xv, 0x5)));
+		_mm256_storeu_pd(yd + 2*i, _mm256_add_pd(_mm256_loadu_pd(yd + 2*i), ax));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX2__ void axpyAVX2(S n, std::complex<float> a, const std::complex<float> *x, std::complex<float> *y){
+	const __m256 ar = _mm256_set1_ps(a.real()), ai = _mm256_set1_ps(a.imag());
+	const float *xd = reinterpret_cast<const float*>(x);
+	float *yd = reinterpret_cast<float*>(y);
+	S i = 0;
+	for(; i + 4 <= n; i += 4){
+		__m256 xv = _mm256_loadu_ps(xd + 2*i);
+		__m256 ax = _mm256_fmaddsub_ps(ar, xv, _mm256_mul_ps(ai, _mm256_permute_ps(xv, 0xB1)));
+		_mm256_storeu_ps(yd + 2*i, _mm256_add_ps(_mm256_loadu_ps(yd + 2*i), ax));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+
+/*AVX-512F*/
+
+//8 doubles (or 8 pairs of floats) at the indices p[0..7]
+template<typename I>
+__SIMD_AVX512__ inline __m512d gather8d(const double *x, const I *p){
+	return _mm512_insertf64x4(_mm512_castpd256_pd512(gather4d(x, p)), gather4d(x, p + 4), 1);
+}
+
+//16 floats at the indices p[0..15]
+template<typename I>
+__SIMD_AVX512__ inline __m512 gather16f(const float *x, const I *p){
+	__m256d lo = _mm256_castps_pd(gather8f(x, p));
+	__m256d hi = _mm256_castps_pd(gather8f(x, p + 8));
+	return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1));
+}
+
+template<typename S, typename I>
+__SIMD_AVX512__ void csrRowsAVX512(const S *rows, const I *cols, const double *vals, const double *x, double *y, S r0, S r1){
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m512d acc = _mm512_setzero_pd();
+		for(; k + 8 <= e; k += 8){
+			acc = _mm512_fmadd_pd(_mm512_loadu_pd(vals + k), gather8d(x, cols + k), acc);
+		}
+		//the rows of the generated matrices are short, the rest goes by half registers
+		__m256d acc4 = _mm256_setzero_pd();
+		for(; k + 4 <= e; k += 4){
+			acc4 = _mm256_fmadd_pd(_mm256_loadu_pd(vals + k), gather4d(x, cols + k), acc4);
+		}
+		double sum = _mm512_reduce_add_pd(acc) + hsum4d(acc4);
+		for(; k < e; k++){
+			sum += vals[k] * x[cols[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX512__ void csrRowsAVX512(const S *rows, const I *cols, const float *vals, const float *x, float *y, S r0, S r1){
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m512 acc = _mm512_setzero_ps();
+		for(; k + 16 <= e; k += 16){
+			acc = _mm512_fmadd_ps(_mm512_loadu_ps(vals + k), gather16f(x, cols + k), acc);
+		}
+		__m256 acc8 = _mm256_setzero_ps();
+		for(; k + 8 <= e; k += 8){
+			acc8 = _mm256_fmadd_ps(_mm256_loadu_ps(vals + k), gather8f(x, cols + k), acc8);
+		}
+		float sum = _mm512_reduce_add_ps(acc) + hsum8f(acc8);
+		for(; k < e; k++){
+			sum += vals[k] * x[cols[k]];
+		}
+		y[i] = sum;
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX512__ void csrRowsAVX512(const S *rows, const I *cols, const std::complex<double> *vals, const std::complex<double> *x, std::complex<double> *y, S r0, S r1){
+	const double *v = reinterpret_cast<const double*>(vals);
+	const double *xd = reinterpret_cast<const double*>(x);
+	const __m512d sign = _mm512_set_pd(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m512d acc = _mm512_setzero_pd(), accs = _mm512_setzero_pd();
+		for(; k + 4 <= e; k += 4){
+			__m512d va = _mm512_loadu_pd(v + 2*k);
+			__m256d lo = _mm256_set_m128d(_mm_loadu_pd(xd + 2*S(cols[k + 1])), _mm_loadu_pd(xd + 2*S(cols[k])));
+			__m256d hi = _mm256_set_m128d(_mm_loadu_pd(xd + 2*S(cols[k + 3])), _mm_loadu_pd(xd + 2*S(cols[k + 2])));
+			__m512d xv = _mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1);
+			acc = _mm512_fmadd_pd(va, xv, acc);
+			accs = _mm512_fmadd_pd(va, _mm512_permute_pd(xv, 0x55), accs);
+		}
+		__m256d acc2 = _mm256_setzero_pd(), accs2 = _mm256_setzero_pd();
+		for(; k + 2 <= e; k += 2){
+			__m256d va = _mm256_loadu_pd(v + 2*k);
+			__m256d xv = _mm256_set_m128d(_mm_loadu_pd(xd + 2*S(cols[k + 1])), _mm_loadu_pd(xd + 2*S(cols[k])));
+			acc2 = _mm256_fmadd_pd(va, xv, acc2);
+			accs2 = _mm256_fmadd_pd(va, _mm256_permute_pd(xv, 0x5), accs2);
+		}
+		double re = _mm512_reduce_add_pd(_mm512_mul_pd(acc, sign)) + hsum4d(_mm256_mul_pd(acc2, _mm512_castpd512_pd256(sign)));
+		double im = _mm512_reduce_add_pd(accs) + hsum4d(accs2);
+		for(; k < e; k++){
+			const double *xc = xd + 2*S(cols[k]);
+			re += v[2*k] * xc[0] - v[2*k + 1] * xc[1];
+			im += v[2*k] * xc[1] + v[2*k + 1] * xc[0];
+		}
+		y[i] = std::complex<double>(re, im);
+	}
+}
+
+template<typename S, typename I>
+__SIMD_AVX512__ void csrRowsAVX512(const S *rows, const I *cols, const std::complex<float> *vals, const std::complex<float> *x, std::complex<float> *y, S r0, S r1){
+	const float *v = reinterpret_cast<const float*>(vals);
+	const float *xd = reinterpret_cast<const float*>(x);
+	const __m512 sign = _mm512_set_ps(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+
+	for(S i = r0; i < r1; i++){
+		S k = rows[i], e = rows[i + 1];
+		__m512 acc = _mm512_setzero_ps(), accs = _mm512_setzero_ps();
+		for(; k + 8 <= e; k += 8){
+			__m512 va = _mm512_loadu_ps(v + 2*k);
+			__m512 xv = _mm512_castpd_ps(gather8d(reinterpret_cast<const double*>(x), cols + k));
+			acc = _mm512_fmadd_ps(va, xv, acc);
+			accs = _mm512_fmadd_ps(va, _mm512_permute_ps(xv, 0xB1), accs);
+		}
+		__m256 acc4 = _mm256_setzero_ps(), accs4 = _mm256_setzero_ps();
+		for(; k + 4 <= e; k += 4){
+			__m256 va = _mm256_loadu_ps(v + 2*k);
+			__m256 xv = _mm256_castpd_ps(gather4d(reinterpret_cast<const double*>(x), cols + k));
+			acc4 = _mm256_fmadd_ps(va, xv, acc4);
+			accs4 = _mm256_fmadd_ps(va, _mm256_permute_ps(xv, 0xB1), accs4);
+		}
+		float re = _mm512_reduce_add_ps(_mm512_mul_ps(acc, sign)) + hsum8f(_mm256_mul_ps(acc4, _mm512_castps512_ps256(sign)));
+		float im = _mm512_reduce_add_ps(accs) + hsum8f(accs4);
+		for(; k < e; k++){
+			const float *xc = xd + 2*S(cols[k]);
+			re += v[2*k] * xc[0] - v[2*k + 1] * xc[1];
+			im += v[2*k] * xc[1] + v[2*k + 1] * xc[0];
+		}
+		y[i] = std::complex<float>(re, im);
+	}
+}
+
+template<typename S>
+__SIMD_AVX512__ void axpyAVX512(S n, double a, const double *x, double *y){
+	const __m512d va = _mm512_set1_pd(a);
+	S i = 0;
+	for(; i + 8 <= n; i += 8){
+		_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX512__ void axpyAVX512(S n, float a, const float *x, float *y){
+	const __m512 va = _mm512_set1_ps(a);
+	S i = 0;
+	for(; i + 16 <= n; i += 16){
+		_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX512__ void axpyAVX512(S n, std::complex<double> a, const std::complex<double> *x, std::complex<double> *y){
+	const __m512d ar = _mm512_set1_pd(a.real()), ai = _mm512_set1_pd(a.imag());
+	const double *xd = reinterpret_cast<const double*>(x);
+	double *yd = reinterpret_cast<double*>(y);
+	S i = 0;
+	for(; i + 4 <= n; i += 4){
+		__m512d xv = _mm512_loadu_pd(xd + 2*i);
+		__m512d ax = _mm512_fmaddsub_pd(ar, xv, _mm512_mul_pd(ai, _mm512_permute_pd(xv, 0x55)));
+		_mm512_storeu_pd(yd + 2*i, _mm512_add_pd(_mm512_loadu_pd(yd + 2*i), ax));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+template<typename S>
+__SIMD_AVX512__ void axpyAVX512(S n, std::complex<float> a, const std::complex<float> *x, std::complex<float> *y){
+	const __m512 ar = _mm512_set1_ps(a.real()), ai = _mm512_set1_ps(a.imag());
+	const float *xd = reinterpret_cast<const float*>(x);
+	float *yd = reinterpret_cast<float*>(y);
+	S i = 0;
+	for(; i + 8 <= n; i += 8){
+		__m512 xv = _mm512_loadu_ps(xd + 2*i);
+		__m512 ax = _mm512_fmaddsub_ps(ar, xv, _mm512_mul_ps(ai, _mm512_permute_ps(xv, 0xB1)));
+		_mm512_storeu_ps(yd + 2*i, _mm512_add_ps(_mm512_loadu_ps(yd + 2*i), ax));
+	}
+	axpyScalar(n - i, a, x + i, y + i);
+}
+
+#endif
+
+
+/*Kernels used by the library, on the level of simdGetLevel()*/
+
+//y[i] = sum of vals[k]*x[cols[k]] on the row i of the CSR (rows, cols, vals), for the rows [r0, r1)
+template<typename T, typename S>
+void csrRowsProd(const S *rows, const S *cols, const T *vals, const T *x, T *y, S r0, S r1){
+#ifdef __SMG2S_SIMD_X86__
+	int level = simdGetLevel();
+
+	if(level != SIMD_SCALAR && sizeof(S) == 4){
+		const int32_t *c = reinterpret_cast<const int32_t*>(cols);
+		if(level == SIMD_AVX512){
+			csrRowsAVX512(rows, c, vals, x, y, r0, r1);
+		}else{
+			csrRowsAVX2(rows, c, vals, x, y, r0, r1);
+		}
+		return;
+	}
+	if(level != SIMD_SCALAR && sizeof(S) == 8){
+		const int64_t *c = reinterpret_cast<const int64_t*>(cols);
+		if(level == SIMD_AVX512){
+			csrRowsAVX512(rows, c, vals, x, y, r0, r1);
+		}else{
+			csrRowsAVX2(rows, c, vals, x, y, r0, r1);
+		}
+		return;
+	}
+#endif
+	csrRowsScalar(rows, cols, vals, x, y, r0, r1);
+}
+
+//y[i] += a*x[i], i in [0, n)
+template<typename T, typename S>
+void simdAxpy(S n, T a, const T *x, T *y){
+#ifdef __SMG2S_SIMD_X86__
+	int level = simdGetLevel();
+
+	if(level == SIMD_AVX512){
+		axpyAVX512(n, a, x, y);
+		return;
+	}
+	if(level == SIMD_AVX2){
+		axpyAVX2(n, a, x, y);
+		return;
+	}
+#endif
+	axpyScalar(n, a, x, y);
+}
+
+#endif
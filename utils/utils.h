@@ -30,6 +30,7 @@ SOFTWARE.
 #include <ctime>
 #include <cstdlib>
 #include <map>
+#include <vector>
 
 template<class T>
 T random_unint(T min, T max)
@@ -108,6 +109,21 @@ __int64_t factorial(__int64_t start, __int64_t end)
         return value;
 }
 
+/*1/k! for k = 0..n, by successive divisions: no factorial is formed, so there is no overflow
+  for large n (the terms only underflow to 0 past k = 170 in double)*/
+template<typename S>
+std::vector<double> invFactorials(S n)
+{
+	std::vector<double> invfac(n + 1);
+
+	invfac[0] = 1.0;
+	for(S k = 1; k <= n; k++){
+		invfac[k] = invfac[k - 1]/double(k);
+	}
+
+	return invfac;
+}
+
 template<typename S>
 struct Nilpotency
 {